@@ -0,0 +1,130 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// The host side of host/user/user.h and host/kernel/stat.h.
+
+#undef stat
+#undef fstat
+#undef printf
+#undef fprintf
+#undef malloc
+#undef free
+
+struct allocstats allocstats;
+
+static void
+printint(FILE *f, int xx, int base, int sgn)
+{
+    uint x = sgn && xx < 0 ? -xx : xx;
+
+    if(base == 10)
+        fprintf(f, sgn && xx < 0 ? "-%u" : "%u", x);
+    else
+        fprintf(f, "%X", x);
+}
+
+// user/printf.c's formats on a host stream
+static void
+xv6_vprintf(FILE *f, const char *fmt, va_list ap)
+{
+    const char *s;
+    int c, i;
+
+    for(i = 0; fmt[i]; i++){
+        c = fmt[i] & 0xff;
+        if(c != '%'){
+            putc(c, f);
+            continue;
+        }
+        c = fmt[++i] & 0xff;
+        if(c == 0)
+            break;
+        if(c == 'd'){
+            printint(f, va_arg(ap, int), 10, 1);
+        } else if(c == 'l'){
+            printint(f, va_arg(ap, uint64), 10, 0);
+        } else if(c == 'x'){
+            printint(f, va_arg(ap, int), 16, 0);
+        } else if(c == 'p'){
+            fprintf(f, "0x%016lX", (unsigned long)va_arg(ap, uint64));
+        } else if(c == 's'){
+            s = va_arg(ap, char*);
+            fputs(s ? s : "(null)", f);
+        } else if(c == 'c'){
+            putc(va_arg(ap, uint), f);
+        } else if(c == '%'){
+            putc('%', f);
+        } else {
+            putc('%', f);
+            putc(c, f);
+        }
+    }
+}
+
+void
+xv6_printf(const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    xv6_vprintf(stdout, fmt, ap);
+    va_end(ap);
+}
+
+void
+xv6_fprintf(int fd, const char *fmt, ...)
+{
+    va_list ap;
+
+    fflush(stdout);
+    va_start(ap, fmt);
+    xv6_vprintf(fd == 2 ? stderr : stdout, fmt, ap);
+    va_end(ap);
+}
+
+// Each block carries its size in front, 16 bytes to keep the
+// alignment malloc gives.
+void*
+xv6_malloc(uint n)
+{
+    uint64 *p = malloc(n + 16);
+
+    if(p == 0)
+        return 0;
+    p[0] = n;
+    allocstats.calls++;
+    allocstats.bytes += n;
+    allocstats.live += n;
+    if(allocstats.live > allocstats.peak)
+        allocstats.peak = allocstats.live;
+    return p + 2;
+}
+
+void
+xv6_free(void *ap)
+{
+    uint64 *p = ap;
+
+    if(p == 0)
+        return;
+    p -= 2;
+    allocstats.live -= p[0];
+    free(p);
+}
+
+int
+xv6_fstat(int fd, struct xv6_stat *st)
+{
+    struct stat hs;
+
+    if(fstat(fd, &hs) < 0)
+        return -1;
+    memset(st, 0, sizeof(*st));
+    st->dev = hs.st_dev;
+    st->ino = hs.st_ino;
+    st->type = S_ISDIR(hs.st_mode) ? T_DIR : S_ISREG(hs.st_mode) ? T_FILE : T_DEVICE;
+    st->nlink = hs.st_nlink;
+    st->size = hs.st_size;
+    return 0;
+}
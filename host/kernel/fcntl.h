@@ -0,0 +1,2 @@
+// the host's open flags under their xv6 names
+#define O_CREATE O_CREAT
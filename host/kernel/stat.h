@@ -0,0 +1,6 @@
+// xv6's struct stat, renamed away from the host's
+#define stat xv6_stat
+#define fstat xv6_fstat
+#include "../../kernel/stat.h"
+
+int xv6_fstat(int fd, struct xv6_stat *st);
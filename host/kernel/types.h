@@ -0,0 +1,13 @@
+// Host build of xv6 user code. This directory comes before the
+// source tree on the include path: the libc headers are pulled in
+// here, ahead of everything else, so that the xv6 headers that
+// follow can rename what would clash with them.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <sys/stat.h>
+
+#include "../../kernel/types.h"
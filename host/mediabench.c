@@ -0,0 +1,282 @@
+#include <time.h>
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+#include "user/nanojpeg.h"
+#include "user/mp4.h"
+#include "user/wav.h"
+#include "user/rgb.h"
+
+// mediabench [-n runs] [dir]
+//
+// Time the media code that xv6 runs in user space, built for the
+// host: JPEG decoding (user/nanojpeg.c) at each scale, MP4 indexing
+// (user/mp4.c), RGB565 conversion (user/rgb.c) and PCM conversion
+// (user/wav.c), over the files in dir that go into fs.img. Each line
+// gives the time of one run, the throughput, and the allocations of
+// one run. A codec that fails makes the exit status 1, so a short
+// run doubles as a smoke test.
+
+#undef printf
+#undef fprintf
+
+#define JPEG_FILE   "hutao.jpeg"
+#define MP4_FILE    "av_1.mp4"
+#define WAV_FILE    "test.wav"
+#define WAV_CHUNK   4096        // frames per wavconvert call
+#define RGB_FRAMES  50          // per run
+
+static int runs = 10;
+static int failed;
+
+static uchar *jpeg;
+static int jpegsize;
+static int mp4fd;
+static uchar *pcmdata;
+static uint pcmbytes;
+static struct wavinfo wav;
+static short *pcmout;
+static uint16 *frame;
+static uchar *rle;
+static int rlesize;
+static char *window;
+
+static double
+now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uchar*
+slurp(const char *name, int *size)
+{
+    struct xv6_stat st;
+    uchar *p;
+    int fd;
+
+    if((fd = open(name, O_RDONLY)) < 0 || fstat(fd, &st) < 0){
+        fprintf(stderr, "mediabench: cannot open %s\n", name);
+        exit(1);
+    }
+    p = malloc(st.size);
+    if(p == 0 || read(fd, p, st.size) != (int)st.size){
+        fprintf(stderr, "mediabench: cannot read %s\n", name);
+        exit(1);
+    }
+    close(fd);
+    *size = st.size;
+    return p;
+}
+
+// Run f runs times. work is what one run gets through, in units.
+static void
+bench(const char *name, int (*f)(int), int arg, double work, const char *unit)
+{
+    struct allocstats a0;
+    double t;
+    int i;
+
+    a0 = allocstats;
+    allocstats.peak = allocstats.live;
+    t = now();
+    for(i = 0; i < runs; i++){
+        if(f(arg) < 0){
+            printf("%-20s FAILED\n", name);
+            failed = 1;
+            return;
+        }
+    }
+    t = (now() - t) / runs;
+    printf("%-20s %9.3f ms %10.1f %s/s %6lu allocs %8lu KB peak\n",
+           name, t * 1000, work / t, unit,
+           (unsigned long)((allocstats.calls - a0.calls) / runs),
+           (unsigned long)((allocstats.peak - a0.live) / 1024));
+}
+
+static int
+run_jpeg(int scale)
+{
+    int r;
+
+    njSetScale(scale);
+    r = njDecode(jpeg, jpegsize) == NJ_OK ? 0 : -1;
+    njDone();
+    return r;
+}
+
+static int
+run_mp4(int unused)
+{
+    struct mp4file mf;
+    struct mp4sample s;
+    int i;
+    uint n;
+
+    if(lseek(mp4fd, 0, SEEK_SET) < 0 || mp4_open(mp4fd, &mf) < 0)
+        return -1;
+    for(i = 0; i < mf.ntrack; i++)
+        for(n = 0; n < mf.track[i].nsamples; n++)
+            if(mp4_sample(&mf.track[i], n, &s) < 0)
+                return -1;
+    mp4_close(&mf);
+    return 0;
+}
+
+static int
+run_rgb(int unused)
+{
+    int i;
+
+    for(i = 0; i < RGB_FRAMES; i++)
+        rgb_convert(frame, window, RGB_WIDTH * RGB_HEIGHT);
+    return 0;
+}
+
+static int
+run_tiles(int unused)
+{
+    int i;
+
+    for(i = 0; i < RGB_FRAMES; i++)
+        if(rgb_tiles(rle, rle + rlesize, RGB_NTILES, window) < 0)
+            return -1;
+    return 0;
+}
+
+// wav.data as PCM of the given layout
+static int
+run_wav(int unused)
+{
+    uint n, total = pcmbytes / wav.block_align;
+
+    for(n = 0; n < total; n += WAV_CHUNK)
+        wavconvert(pcmdata + n * wav.block_align, total - n < WAV_CHUNK ? total - n : WAV_CHUNK,
+                   &wav, pcmout);
+    return 0;
+}
+
+// A key frame as rgbenc would make it of a picture without runs:
+// each tile one literal of all its pixels.
+static void
+make_frames(void)
+{
+    int t, i, x, y;
+    uchar *p;
+
+    frame = malloc(RGB_WIDTH * RGB_HEIGHT * 2);
+    window = malloc(RGB_WIDTH * RGB_HEIGHT);
+    rle = p = malloc(RGB_MAXFRAME);
+    for(i = 0; i < RGB_WIDTH * RGB_HEIGHT; i++)
+        frame[i] = i * 2654435761u >> 16;
+    for(t = 0; t < RGB_NTILES; t++){
+        *p++ = t;
+        *p++ = t >> 8;
+        *p++ = RGB_TILE_PIXELS - 1;
+        for(i = 0; i < RGB_TILE_PIXELS; i++){
+            x = t % RGB_TILES_X * RGB_TILE_W + i % RGB_TILE_W;
+            y = t / RGB_TILES_X * RGB_TILE_H + i / RGB_TILE_W;
+            *p++ = frame[y * RGB_WIDTH + x];
+            *p++ = frame[y * RGB_WIDTH + x] >> 8;
+        }
+    }
+    rlesize = p - rle;
+}
+
+static void
+load_wav(void)
+{
+    int fd, n;
+
+    if((fd = open(WAV_FILE, O_RDONLY)) < 0 || wavopen(fd, &wav) < 0){
+        fprintf(stderr, "mediabench: cannot open %s\n", WAV_FILE);
+        exit(1);
+    }
+    pcmdata = malloc(wav.data_len);
+    for(pcmbytes = 0; pcmbytes < wav.data_len; pcmbytes += n)
+        if((n = read(fd, pcmdata + pcmbytes, wav.data_len - pcmbytes)) <= 0)
+            break;
+    close(fd);
+    pcmout = malloc(WAV_CHUNK * WAV_OUT_FRAME);
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const struct { const char *name; int channel, bits; } layouts[] = {
+        { "wav s16 stereo", 2, 16 },
+        { "wav s16 mono", 1, 16 },
+        { "wav u8 stereo", 2, 8 },
+        { "wav s24 stereo", 2, 24 },
+    };
+    char name[32];
+    struct mp4file mf;
+    double samples = 0;
+    int i, w, h;
+
+    for(; argc > 1 && argv[1][0] == '-'; argc--, argv++){
+        if(strcmp(argv[1], "-n") == 0 && argc > 2){
+            runs = atoi(argv[2]);
+            argc--;
+            argv++;
+        } else {
+            fprintf(stderr, "usage: mediabench [-n runs] [dir]\n");
+            exit(1);
+        }
+    }
+    if(runs < 1)
+        runs = 1;
+    if(argc > 1 && chdir(argv[1]) < 0){
+        fprintf(stderr, "mediabench: cannot cd to %s\n", argv[1]);
+        exit(1);
+    }
+
+    jpeg = slurp(JPEG_FILE, &jpegsize);
+    njInit();
+    njSetScale(0);
+    if(njDecode(jpeg, jpegsize) != NJ_OK){
+        fprintf(stderr, "mediabench: cannot decode %s\n", JPEG_FILE);
+        exit(1);
+    }
+    w = njGetWidth();
+    h = njGetHeight();
+    njDone();
+    printf("%s: %dx%d, %d bytes\n", JPEG_FILE, w, h, jpegsize);
+    for(i = 0; i <= 3; i++){
+        snprintf(name, sizeof(name), "jpeg 1/%d", 1 << i);
+        bench(name, run_jpeg, i, (double)w * h / 1e6, "Mpixel");
+    }
+
+    if((mp4fd = open(MP4_FILE, O_RDONLY)) < 0 || mp4_open(mp4fd, &mf) < 0){
+        fprintf(stderr, "mediabench: cannot open %s\n", MP4_FILE);
+        exit(1);
+    }
+    for(i = 0; i < mf.ntrack; i++)
+        samples += mf.track[i].nsamples;
+    printf("%s: %d tracks, %.0f samples\n", MP4_FILE, mf.ntrack, samples);
+    mp4_close(&mf);
+    bench("mp4 index", run_mp4, 0, samples / 1e3, "ksample");
+
+    make_frames();
+    printf("rgb: %dx%d frames, %d byte key frame\n", RGB_WIDTH, RGB_HEIGHT, rlesize);
+    bench("rgb565 convert", run_rgb, 0, RGB_FRAMES * RGB_WIDTH * RGB_HEIGHT / 1e6, "Mpixel");
+    bench("rgb tiles", run_tiles, 0, RGB_FRAMES * RGB_WIDTH * RGB_HEIGHT / 1e6, "Mpixel");
+
+    // the same bytes taken as each layout the players convert
+    load_wav();
+    printf("%s: %d Hz, %d bytes\n", WAV_FILE, wav.sample_rate, pcmbytes);
+    for(i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++){
+        wav.format = WAV_FORMAT_PCM;
+        wav.channel = layouts[i].channel;
+        wav.bits_per_sample = layouts[i].bits;
+        wav.block_align = layouts[i].channel * layouts[i].bits / 8;
+        bench(layouts[i].name, run_wav, 0, (double)pcmbytes / wav.block_align / 1e6, "Mframe");
+    }
+
+    close(mp4fd);
+    return failed;
+}
@@ -0,0 +1,20 @@
+// The xv6 user library on the host. System calls are the host's;
+// printf keeps the xv6 formats (%l is a 64-bit number cut to 32
+// bits, as in user/printf.c); malloc is counted in allocstats.
+#define printf  xv6_printf
+#define fprintf xv6_fprintf
+#define malloc  xv6_malloc
+#define free    xv6_free
+
+void xv6_printf(const char *fmt, ...);
+void xv6_fprintf(int fd, const char *fmt, ...);
+void *xv6_malloc(uint n);
+void xv6_free(void *p);
+
+struct allocstats {
+    uint64 calls;
+    uint64 bytes;           // allocated in all
+    uint64 live;            // not freed yet
+    uint64 peak;            // of live
+};
+extern struct allocstats allocstats;
@@ -1,6 +1,6 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a hash table of buf structures holding
 // cached copies of disk block contents.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
@@ -12,6 +12,10 @@
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
 //     so do not keep them longer than necessary.
+// * bread_many reads several blocks with one notification of
+//     the disk, so that their requests overlap.
+// * bprefetch starts reading blocks that will soon be wanted;
+//     a later bread of one waits only for what is left of its read.
 
 
 #include "types.h"
@@ -23,33 +27,247 @@
 #include "fs.h"
 #include "buf.h"
 
-struct {
+#define NBUCKET 127
+#define NODEV   (~0U)   // dev of a buf that holds no block
+#define BHASH(dev, blockno) (((dev) + (blockno)) % NBUCKET)
+
+// A buf is in the bucket its block hashes to, or in none while it
+// is being recycled. Each bucket has its own lock, so lookups of
+// different blocks do not contend. Recycling picks bufs with a
+// clock over buf[] instead of an LRU list: a use sets buf.recent,
+// the clock hand clears it, and an idle buf it finds clear goes.
+struct bucket {
   struct spinlock lock;
-  struct buf buf[NBUF];
+  struct buf *head;
+};
+
+// The cache takes up to a quarter of the memory free at boot, in
+// bufs whose data comes from the page allocator, each the block size
+// of its disk, so that a disk of small blocks gets more of them.
+// Bufs start on the dead list, without data, and are given data as
+// blocks are first wanted. When kalloc() runs out, bshrink() gives
+// the data of idle bufs back, down to NBUF bufs; the bufs left
+// without data wait on the dead list until more than half the boot
+// memory is free again. With more than one disk in use, a disk that
+// holds its share of the budget recycles its own bufs, so that
+// streaming from one does not push the blocks of another out.
+struct {
+  struct buf buf[NBUFMAX];
+  struct bucket bucket[NBUCKET];
+  uint hand;    // clock hand into buf[]
+  int nbuf;     // # of buf[] ever given data
+  uint bsize[NDISK];  // block size of each disk, 0 until set
+  uint64 dbytes[NDISK];  // of data held for each disk
+  int ndisk;    // # of disks with a block size set
 
-  // Linked list of all buffers, through prev/next.
-  // Sorted by how recently the buffer was used.
-  // head.next is most recent, head.prev is least.
-  struct buf head;
+  struct spinlock lock;  // protects the rest
+  int nlive;    // # of bufs with data
+  uint64 bytes; // of their data
+  struct buf *dead;
+  uint64 budget;
+  uint64 reserve;
 } bcache;
 
 void
 binit(void)
 {
   struct buf *b;
+  uint64 avail = bd_freemem();
+  int i;
 
+  bcache.budget = avail / 4;
+  if(bcache.budget < (uint64)NBUF * MAXBSIZE)
+    bcache.budget = (uint64)NBUF * MAXBSIZE;
+  bcache.reserve = avail / 2;
   initlock(&bcache.lock, "bcache");
 
-  // Create linked list of buffers
-  bcache.head.prev = &bcache.head;
-  bcache.head.next = &bcache.head;
-  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
+  for(i = 0; i < NBUCKET; i++)
+    initlock(&bcache.bucket[i].lock, "bcache.bucket");
+  for(b = bcache.buf+NBUFMAX; b-- > bcache.buf; ){
     initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+    b->dev = NODEV;
+    b->next = bcache.dead;
+    bcache.dead = b;
   }
+  printf("bcache: %d MB\n", (int)(bcache.budget >> 20));
+}
+
+// Set the block size of dev, before any block of it is read.
+void
+bsetsize(uint dev, uint size)
+{
+  if(bcache.bsize[dev] == 0)
+    __sync_fetch_and_add(&bcache.ndisk, 1);
+  bcache.bsize[dev] = size;
+}
+
+// The block size of dev.
+uint
+blksize(uint dev)
+{
+  return bcache.bsize[dev] ? bcache.bsize[dev] : BSIZE;
+}
+
+// The buf of block blockno on dev in bk, or 0.
+// Caller holds bk->lock.
+static struct buf*
+blookup(struct bucket *bk, uint dev, uint blockno)
+{
+  struct buf *b;
+
+  for(b = bk->head; b != 0; b = b->next)
+    if(b->dev == dev && b->blockno == blockno)
+      return b;
+  return 0;
+}
+
+// Put b, taken out by bvictim(), into bk for block blockno on dev.
+// Caller holds bk->lock.
+static void
+binsert(struct bucket *bk, struct buf *b, uint dev, uint blockno)
+{
+  b->dev = dev;
+  b->blockno = blockno;
+  b->valid = 0;
+  b->refcnt = 0;
+  b->recent = 1;
+  b->bucket = bk - bcache.bucket;
+  b->next = bk->head;
+  bk->head = b;
+  if(dev != NODEV)
+    __sync_fetch_and_add(&bcache.dbytes[dev], b->size);
+}
+
+// Take an idle buf out of its bucket for reuse: one that nobody
+// holds, the disk is not reading ahead into, and that has not been
+// used since the clock hand last passed; one of disk dev, unless dev
+// is NODEV. 0 if there is none.
+static struct buf*
+bvictim(uint dev)
+{
+  struct bucket *bk;
+  struct buf *b, **pp;
+  int i;
+
+  if(bcache.nbuf == 0)
+    return 0;
+  for(i = 0; i < 3*bcache.nbuf; i++){
+    b = &bcache.buf[__sync_fetch_and_add(&bcache.hand, 1) % bcache.nbuf];
+    bk = &bcache.bucket[b->bucket];
+    acquire(&bk->lock);
+    // b->bucket was read without the lock; b only counts if it is
+    // still in bk.
+    for(pp = &bk->head; *pp != 0 && *pp != b; pp = &(*pp)->next)
+      ;
+    if(*pp == b && b->refcnt == 0 && !b->disk && (dev == NODEV || b->dev == dev)){
+      if(!b->recent){
+        *pp = b->next;
+        if(b->dev != NODEV)
+          __sync_fetch_and_sub(&bcache.dbytes[b->dev], b->size);
+        release(&bk->lock);
+        b->ahead = 0;
+        return b;
+      }
+      b->recent = 0;
+    }
+    release(&bk->lock);
+  }
+  return 0;
+}
+
+// Put b, whose data has been given back, on the dead list.
+// Caller holds bcache.lock.
+static void
+bdead(struct buf *b)
+{
+  b->data = 0;
+  b->dev = NODEV;
+  bcache.bytes -= b->size;
+  b->next = bcache.dead;
+  bcache.dead = b;
+}
+
+// A buf for a new block of dev, taken out of any bucket: one of
+// dev's own if dev holds its share of the cache, else a dead one
+// given data while the cache is under budget and memory is
+// plentiful, else a recycled one. 0 if every buf is busy.
+static struct buf*
+bnew(uint dev)
+{
+  uint size = blksize(dev);
+  struct buf *b = 0;
+
+  if(bcache.ndisk > 1 && bcache.dbytes[dev] >= bcache.budget / bcache.ndisk)
+    b = bvictim(dev);
+  if(b == 0 && bcache.dead != 0 && bcache.bytes + size <= bcache.budget &&
+     bd_freemem() > bcache.reserve){
+    acquire(&bcache.lock);
+    if((b = bcache.dead) != 0){
+      bcache.dead = b->next;
+      bcache.nlive++;
+      bcache.bytes += size;
+      b->size = size;
+      if(b - bcache.buf >= bcache.nbuf)
+        bcache.nbuf = b - bcache.buf + 1;
+    }
+    release(&bcache.lock);
+    if(b != 0 && (b->data = bd_malloc(size)) == 0){
+      acquire(&bcache.lock);
+      bcache.nlive--;
+      bdead(b);
+      release(&bcache.lock);
+      b = 0;
+    }
+  }
+  if(b == 0)
+    b = bvictim(NODEV);
+  if(b != 0 && b->size != size){
+    // one of a disk with another block size
+    bd_free(b->data);
+    acquire(&bcache.lock);
+    bcache.bytes = bcache.bytes - b->size + size;
+    b->size = size;
+    release(&bcache.lock);
+    if((b->data = bd_malloc(size)) == 0){
+      acquire(&bcache.lock);
+      bcache.nlive--;
+      bdead(b);
+      release(&bcache.lock);
+      b = 0;
+    }
+  }
+  return b;
+}
+
+// Give the data of up to n idle bufs back to the page allocator,
+// keeping NBUF. Returns how many were given back.
+int
+bshrink(int n)
+{
+  struct buf *b;
+  int i;
+
+  for(i = 0; i < n; i++){
+    acquire(&bcache.lock);
+    if(bcache.nlive <= NBUF){
+      release(&bcache.lock);
+      break;
+    }
+    bcache.nlive--;
+    release(&bcache.lock);
+
+    if((b = bvictim(NODEV)) == 0){
+      acquire(&bcache.lock);
+      bcache.nlive++;
+      release(&bcache.lock);
+      break;
+    }
+    bd_free(b->data);
+    acquire(&bcache.lock);
+    bdead(b);
+    release(&bcache.lock);
+  }
+  return i;
 }
 
 // Look through buffer cache for block on device dev.
@@ -58,34 +276,44 @@ binit(void)
 static struct buf*
 bget(uint dev, uint blockno)
 {
-  struct buf *b;
+  struct bucket *bk = &bcache.bucket[BHASH(dev, blockno)];
+  struct buf *b, *victim = 0;
 
-  acquire(&bcache.lock);
+  for(;;){
+    acquire(&bk->lock);
 
-  // Is the block already cached?
-  for(b = bcache.head.next; b != &bcache.head; b = b->next){
-    if(b->dev == dev && b->blockno == blockno){
+    // Is the block already cached?
+    if((b = blookup(bk, dev, blockno)) != 0){
       b->refcnt++;
-      release(&bcache.lock);
+      b->recent = 1;
+      if(victim)
+        binsert(bk, victim, NODEV, 0);
+      release(&bk->lock);
       acquiresleep(&b->lock);
+      if(b->ahead){
+        virtio_disk_wait(b->dev, b);
+        b->ahead = 0;
+        b->valid = 1;
+      }
       return b;
     }
-  }
 
-  // Not cached.
-  // Recycle the least recently used (LRU) unused buffer.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->valid = 0;
-      b->refcnt = 1;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
+    // Not cached.
+    // Use the buf recycled on the last time round.
+    if(victim){
+      binsert(bk, victim, dev, blockno);
+      victim->refcnt = 1;
+      release(&bk->lock);
+      acquiresleep(&victim->lock);
+      return victim;
     }
+    release(&bk->lock);
+
+    // Recycle one without holding bk->lock, then look again: the
+    // block may have been cached meanwhile.
+    if((victim = bnew(dev)) == 0)
+      panic("bget: no buffers");
   }
-  panic("bget: no buffers");
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -102,6 +330,147 @@ bread(uint dev, uint blockno)
   return b;
 }
 
+// Return a locked buf for a block whose old contents do not
+// matter, without reading it. The caller fills all of it.
+struct buf*
+bclaim(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bget(dev, blockno);
+  b->valid = 1;
+  return b;
+}
+
+// Return locked bufs for the cnt blocks in blocknos, reading all
+// those not cached with one batch of disk requests. The bufs are
+// locked in order, so callers must not race for the same blocks in
+// another order; readi's inode lock sees to that.
+void
+bread_many(uint dev, uint *blocknos, int cnt, struct buf **bs)
+{
+  struct buf *rd[NBATCH];
+  int i, nrd = 0;
+
+  if(cnt > NBATCH)
+    panic("bread_many");
+  for(i = 0; i < cnt; i++){
+    bs[i] = bget(dev, blocknos[i]);
+    if(!bs[i]->valid)
+      rd[nrd++] = bs[i];
+  }
+  if(nrd == 0)
+    return;
+  virtio_disk_start(dev, rd, nrd, 0);
+  for(i = 0; i < nrd; i++){
+    virtio_disk_wait(dev, rd[i]);
+    rd[i]->valid = 1;
+  }
+}
+
+// Read block blockno of dev, of size bytes, into data around the
+// cache: for the superblock, before the block size of dev is known.
+void
+bread_raw(uint dev, uint blockno, uint size, uchar *data)
+{
+  struct buf b;
+
+  memset(&b, 0, sizeof(b));
+  b.dev = dev;
+  b.blockno = blockno;
+  b.size = size;
+  b.data = data;
+  virtio_disk_rw(dev, &b, 0);
+}
+
+// Is the block cached, or on its way there?
+int
+bcached(uint dev, uint blockno)
+{
+  struct bucket *bk = &bcache.bucket[BHASH(dev, blockno)];
+  int r;
+
+  acquire(&bk->lock);
+  r = blookup(bk, dev, blockno) != 0;
+  release(&bk->lock);
+  return r;
+}
+
+// Read the cnt blocks in blocknos, none of them cached, straight
+// into user memory at dst in pagetable with one batch of disk
+// requests, so that their data is never copied. The user pages
+// stay put while the process sleeps here, since xv6 neither pages
+// out nor shares a pagetable between threads.
+// Returns -1 if dst is not mapped.
+int
+bread_user(uint dev, uint *blocknos, int cnt, pagetable_t pagetable, uint64 dst)
+{
+  struct buf bs[NBATCH], *rd[NBATCH];
+  uint64 upa[NBATCH][NUPAGE], va;
+  uint size = blksize(dev);
+  int i, j;
+
+  if(cnt > NBATCH)
+    panic("bread_user");
+  for(i = 0; i < cnt; i++){
+    va = dst + i*size;
+    memset(&bs[i], 0, sizeof(bs[i]));
+    bs[i].dev = dev;
+    bs[i].blockno = blocknos[i];
+    bs[i].size = size;
+    bs[i].upa = upa[i];
+    bs[i].uoff = va % PGSIZE;
+    for(j = 0; j < NUPAGE && PGROUNDDOWN(va) + j*PGSIZE < va + size; j++)
+      if((upa[i][j] = walkaddr(pagetable, PGROUNDDOWN(va) + j*PGSIZE)) == 0)
+        return -1;
+    rd[i] = &bs[i];
+  }
+  virtio_disk_start(dev, rd, cnt, 0);
+  for(i = 0; i < cnt; i++)
+    virtio_disk_wait(dev, rd[i]);
+  return 0;
+}
+
+// Start reading the cnt blocks in blocknos into the cache without
+// waiting for them; bget waits when it finds one still on its way.
+// Blocks already cached are skipped, and so are the rest once no
+// buffer is free: readahead is only worth an idle buffer.
+void
+bprefetch(uint dev, uint *blocknos, int cnt)
+{
+  struct bucket *bk;
+  struct buf *b, *rd[NBATCH];
+  int i, nrd = 0;
+
+  if(cnt > NBATCH)
+    panic("bprefetch");
+  for(i = 0; i < cnt; i++){
+    bk = &bcache.bucket[BHASH(dev, blocknos[i])];
+    acquire(&bk->lock);
+    b = blookup(bk, dev, blocknos[i]);
+    release(&bk->lock);
+    if(b != 0)
+      continue;
+    if((b = bnew(dev)) == 0)
+      break;
+    acquire(&bk->lock);
+    if(blookup(bk, dev, blocknos[i]) != 0){
+      binsert(bk, b, NODEV, 0);
+      release(&bk->lock);
+      continue;
+    }
+    // refcnt stays 0 and nobody holds the sleeplock; disk keeps
+    // bvictim() off the buf until the read is done.
+    binsert(bk, b, dev, blocknos[i]);
+    b->ahead = 1;
+    b->disk = 1;
+    release(&bk->lock);
+    rd[nrd++] = b;
+  }
+  if(nrd > 0)
+    virtio_disk_start(dev, rd, nrd, 0);
+}
+
 // Write b's contents to disk.  Must be locked.
 void
 bwrite(struct buf *b)
@@ -112,42 +481,59 @@ bwrite(struct buf *b)
 }
 
 // Release a locked buffer.
-// Move to the head of the most-recently-used list.
+// Mark it recently used for the clock.
 void
 brelse(struct buf *b)
 {
+  struct bucket *bk;
+
   if(!holdingsleep(&b->lock))
     panic("brelse");
 
   releasesleep(&b->lock);
 
-  acquire(&bcache.lock);
+  // b cannot change buckets while refcnt > 0
+  bk = &bcache.bucket[b->bucket];
+  acquire(&bk->lock);
   b->refcnt--;
-  if (b->refcnt == 0) {
-    // no one is waiting for it.
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
-  }
-  
-  release(&bcache.lock);
+  b->recent = 1;
+  release(&bk->lock);
 }
 
 void
 bpin(struct buf *b) {
-  acquire(&bcache.lock);
+  struct bucket *bk = &bcache.bucket[b->bucket];
+
+  acquire(&bk->lock);
   b->refcnt++;
-  release(&bcache.lock);
+  release(&bk->lock);
 }
 
 void
 bunpin(struct buf *b) {
-  acquire(&bcache.lock);
+  struct bucket *bk = &bcache.bucket[b->bucket];
+
+  acquire(&bk->lock);
   b->refcnt--;
-  release(&bcache.lock);
+  release(&bk->lock);
 }
 
+// The total spins on the bucket locks, for ntas(). With print,
+// also show how often each was found held.
+uint64
+bstat(int print)
+{
+  uint64 tot = 0;
+  int i;
 
+  if(print)
+    printf("bcache: %d of %d buffers hold data, %d KB\n", bcache.nlive, bcache.nbuf,
+           (int)(bcache.bytes >> 10));
+  for(i = 0; i < NBUCKET; i++){
+    if(print && bcache.bucket[i].lock.nts > 0)
+      printf("bcache bucket %d: %d contended acquires, %d spins\n", i,
+             bcache.bucket[i].lock.n, bcache.bucket[i].lock.nts);
+    tot += bcache.bucket[i].lock.nts;
+  }
+  return tot;
+}
@@ -33,6 +33,7 @@ typedef struct sz_info Sz_info;
 
 static Sz_info *bd_sizes; 
 static void *bd_base;   // start address of memory managed by the buddy allocator
+static uint64 bd_nfree; // bytes on the free lists
 static struct spinlock lock;
 
 // Return 1 if bit at position index in array is set to 1
@@ -156,6 +157,7 @@ bd_malloc(uint64 nbytes)
   }
 
   // Found a block; pop it and potentially split it.
+  bd_nfree -= BLK_SIZE(fk);
   char *p = lst_pop(&bd_sizes[k].free);
   bit_set(bd_sizes[k].alloc, blk_index(k, p));
   for(; k > fk; k--) {
@@ -190,6 +192,7 @@ bd_free(void *p) {
   int k;
 
   acquire(&lock);
+  bd_nfree += BLK_SIZE(size(p));
   for (k = size(p); k < MAXSIZE; k++) {
     int bi = blk_index(k, p);
     int buddy = (bi % 2 == 0) ? bi+1 : bi-1;
@@ -368,15 +371,25 @@ bd_init(void *base, void *end) {
     printf("free %d %d\n", free, BLK_SIZE(MAXSIZE)-meta-unavailable);
     panic("bd_init: free mem");
   }
+  bd_nfree = free;
+}
+
+// The number of bytes free, for sizing the buffer cache.
+uint64
+bd_freemem(void)
+{
+  return bd_nfree;
 }
 
 
+// Print how much memory is allocated, in whole KB: the kernel
+// does no floating point, see start().
 int bd_memory() {
 //    bd_print();
     int len = NBLK(0);
-    int used = bd_count_vector(bd_sizes[0].alloc, len);
+    uint64 used = bd_count_vector(bd_sizes[0].alloc, len);
     used *= LEAF_SIZE;
-    len *= LEAF_SIZE;
-    printf("memory used %fMB / %fMB\n", used * 1.0 / 1048576, len * 1.0 / 1048576);
+    printf("memory used %dKB / %dKB\n", (int)(used >> 10),
+           (int)(((uint64)len * LEAF_SIZE) >> 10));
     return 0;
 }
\ No newline at end of file
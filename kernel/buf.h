@@ -1,12 +1,20 @@
 struct buf {
   int valid;   // has data been read from disk?
   int disk;    // does disk "own" buf?
+  int ahead;   // read started by bprefetch, valid once !disk
   uint dev;
   uint blockno;
   struct sleeplock lock;
   uint refcnt;
-  struct buf *prev; // LRU cache list
-  struct buf *next;
-  uchar data[BSIZE];
+  int recent;  // used since the clock hand passed?
+  uint bucket; // bcache hash bucket
+  struct buf *next; // bucket list
+  uint size;   // block size of dev
+  uchar *data; // size bytes from the page allocator, 0 if given back
+  uint64 *upa; // with data 0, direct I/O to these user pages,
+  uint uoff;   //   starting uoff bytes into the first
 };
 
+// # of pages a block of direct I/O can touch
+#define NUPAGE (MAXBSIZE/PGSIZE + 1)
+
@@ -1,5 +1,6 @@
 struct buf;
 struct context;
+struct fpstate;
 struct file;
 struct inode;
 struct pipe;
@@ -12,6 +13,16 @@ struct superblock;
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
+struct buf*     bclaim(uint, uint);
+void            bread_raw(uint, uint, uint, uchar*);
+void            bsetsize(uint, uint);
+uint            blksize(uint);
+void            bread_many(uint, uint*, int, struct buf**);
+void            bprefetch(uint, uint*, int);
+int             bcached(uint, uint);
+int             bread_user(uint, uint*, int, pagetable_t, uint64);
+uint64          bstat(int);
+int             bshrink(int);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
 void            bpin(struct buf*);
@@ -31,11 +42,12 @@ void            fileclose(struct file*);
 struct file*    filedup(struct file*);
 void            fileinit(void);
 int             fileread(struct file*, uint64, int n);
+int             fileseek(struct file*, int off, int whence);
 int             filestat(struct file*, uint64 addr);
 int             filewrite(struct file*, uint64, int n);
 
 // fs.c
-void            fsinit(int);
+int             fsinit(int);
 int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
 struct inode*   ialloc(uint, short);
@@ -46,10 +58,14 @@ void            iput(struct inode*);
 void            iunlock(struct inode*);
 void            iunlockput(struct inode*);
 void            iupdate(struct inode*);
+uint            maxsize(int);
+int             mount(int, struct inode*);
+int             mountpoint(struct inode*);
 int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
 struct inode*   nameipath(char*);
 struct inode*   nameiparent(char*, char*);
+int             pathdisk(char*);
 int             readi(struct inode*, int, uint64, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, int, uint64, uint, uint);
@@ -66,10 +82,14 @@ void            kfree(void *);
 void            kinit(void);
 
 // log.c
+void            loginit(void);
 void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
 void            begin_op(int);
 void            end_op(int);
+void            begin_pathop(int);
+void            join_op(int);
+void            end_pathop(void);
 void            crash_op(int,int);
 
 // pipe.c
@@ -109,6 +129,8 @@ void            procdump(void);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
+void            fpsave(struct fpstate*);
+void            fprestore(struct fpstate*);
 
 // spinlock.c
 void            acquire(struct spinlock*);
@@ -186,8 +208,10 @@ void            plic_complete(int);
 uint64          plic_pending(void);
 
 // virtio_disk.c
-void            virtio_disk_init(int);
+int             virtio_disk_init(int);
 void            virtio_disk_rw(int, struct buf *, int);
+void            virtio_disk_start(int, struct buf **, int, int);
+void            virtio_disk_wait(int, struct buf *);
 void            virtio_disk_intr(int);
 
 // number of elements in fixed-size array
@@ -203,6 +227,7 @@ void           bd_init(void*,void*);
 void           bd_free(void*);
 void           *bd_malloc(uint64);
 int            bd_memory();
+uint64         bd_freemem(void);
 
 struct list {
     struct list *next;
@@ -238,3 +263,6 @@ void            soundinit(void);
 void            soundcardinit(uchar, uchar, uchar);
 void            soundInterrupt(void);
 void            setSoundSampleRate(uint samplerate);
+
+// sysaudio.c
+void            audiorelease(struct proc*);
@@ -21,10 +21,11 @@ exec(char *path, char **argv)
   pagetable_t pagetable = 0, oldpagetable;
   struct proc *p = myproc();
 
-  begin_op(ROOTDEV);
+  // a program not found from the cwd is looked for from /
+  begin_pathop(pathdisk(path) == ROOTDEV ? ROOTDEV : ANYDISK);
 
   if((ip = namei(path)) == 0 && (ip = nameipath(path)) == 0){
-    end_op(ROOTDEV);
+    end_pathop();
     return -1;
   }
   ilock(ip);
@@ -58,7 +59,7 @@ exec(char *path, char **argv)
       goto bad;
   }
   iunlockput(ip);
-  end_op(ROOTDEV);
+  end_pathop();
   ip = 0;
 
   p = myproc();
@@ -109,11 +110,14 @@ exec(char *path, char **argv)
   safestrcpy(p->name, last, sizeof(p->name));
     
   // Commit to the user image.
+  audiorelease(p);
   oldpagetable = p->pagetable;
   p->pagetable = pagetable;
   p->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
+  memset(&p->fpstate, 0, sizeof(p->fpstate));
+  fprestore(&p->fpstate);
   proc_freepagetable(oldpagetable, oldsz);
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
@@ -123,7 +127,7 @@ exec(char *path, char **argv)
     proc_freepagetable(pagetable, sz);
   if(ip){
     iunlockput(ip);
-    end_op(ROOTDEV);
+    end_pathop();
   }
   return -1;
 }
@@ -12,6 +12,7 @@
 #include "file.h"
 #include "stat.h"
 #include "proc.h"
+#include "fcntl.h"
 
 struct devsw devsw[NDEV];
 struct {
@@ -129,6 +130,40 @@ fileread(struct file *f, uint64 addr, int n)
   return r;
 }
 
+// Move the offset of file f to off bytes from the start, the
+// current offset or the end, depending on whence. Only inodes
+// have an offset. Going past the end is allowed, as in read.
+// Returns the new offset.
+int
+fileseek(struct file *f, int off, int whence)
+{
+  uint64 base, pos;
+
+  if(f->type != FD_INODE)
+    return -1;
+
+  ilock(f->ip);
+  if(whence == SEEK_SET)
+    base = 0;
+  else if(whence == SEEK_CUR)
+    base = f->off;
+  else if(whence == SEEK_END)
+    base = f->ip->size;
+  else {
+    iunlock(f->ip);
+    return -1;
+  }
+  // the new offset is returned as an int, so it stops at 2 GB
+  pos = base + off;
+  if((off < 0 && -(uint64)off > base) || pos > maxsize(f->ip->dev) || pos > 0x7fffffff){
+    iunlock(f->ip);
+    return -1;
+  }
+  f->off = pos;
+  iunlock(f->ip);
+  return pos;
+}
+
 // Write to file f.
 // addr is a user virtual address.
 int
@@ -152,7 +187,7 @@ filewrite(struct file *f, uint64 addr, int n)
     // and 2 blocks of slop for non-aligned writes.
     // this really belongs lower down, since writei()
     // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+    int max = ((MAXOPBLOCKS-1-1-2) / 2) * blksize(f->ip->dev);
     int i = 0;
     while(i < n){
       int n1 = n - i;
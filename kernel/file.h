@@ -26,7 +26,15 @@ struct inode {
   short minor;
   short nlink;
   uint size;
-  uint addrs[NDIRECT+1];
+  uint nextent;
+  struct extent ext[NEXTENT];
+  uint indirect;
+  uint dindirect;
+
+  // readahead state of readi()
+  uint ra_next;       // block after the last one read
+  uint ra_end;        // block after the last one prefetched
+  uint ra_win;        // # of blocks to keep read ahead
 };
 
 // map major device number to device functions.
@@ -22,67 +22,202 @@
 #include "file.h"
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
-// there should be one superblock per disk device, but we run with
-// only one device
-struct superblock sb; 
-
-// Read the super block.
-static void
+#define max(a, b) ((a) > (b) ? (a) : (b))
+// one superblock per disk device
+struct superblock sb[NDISK];
+
+// Read the super block. It starts block 1, but the block size is
+// not known yet, so it is looked for at each size in turn, around
+// the cache. Returns -1 if there is none.
+static int
 readsb(int dev, struct superblock *sb)
 {
-  struct buf *bp;
+  uchar *data;
+  uint size;
 
-  bp = bread(dev, 1);
-  memmove(sb, bp->data, sizeof(*sb));
-  brelse(bp);
+  if((data = kalloc()) == 0)
+    return -1;
+  for(size = MINBSIZE; size <= MAXBSIZE; size *= 2){
+    bread_raw(dev, size / MINBSIZE, MINBSIZE, data);
+    memmove(sb, data, sizeof(*sb));
+    if(sb->magic == FSMAGIC && sb->bsize == size)
+      break;
+  }
+  kfree(data);
+  return size <= MAXBSIZE ? 0 : -1;
 }
 
-// Init fs
-void
+// Block allocation is next-fit: the search for a free block starts
+// where the last one ended, so that files written one after another
+// lie one after another. The bitmap is scanned a word of 64 blocks
+// at a time, and the free blocks of each bitmap block (a group) are
+// counted once and then kept up to date, so that a full group is
+// passed over without reading it.
+#define NBGROUP 16  // groups whose free blocks are counted
+#define BFULL   (~0ULL)
+
+static struct {
+  uint next;             // where the next search starts
+  int nfree[NBGROUP];    // free blocks of each group, -1 if not counted
+} alloc[NDISK];
+
+// Init fs. Returns -1 if dev holds none.
+int
 fsinit(int dev) {
-  readsb(dev, &sb);
-  if(sb.magic != FSMAGIC)
-    panic("invalid file system");
-  initlog(dev, &sb);
+  int g;
+
+  if(readsb(dev, &sb[dev]) < 0)
+    return -1;
+  bsetsize(dev, sb[dev].bsize);
+  for(g = 0; g < NBGROUP; g++)
+    alloc[dev].nfree[g] = -1;
+  initlog(dev, &sb[dev]);
+  return 0;
 }
 
-// Zero a block.
+// Zero a block. Its old contents are never read.
 static void
 bzero(int dev, int bno)
 {
   struct buf *bp;
 
-  bp = bread(dev, bno);
-  memset(bp->data, 0, BSIZE);
+  bp = bclaim(dev, bno);
+  memset(bp->data, 0, sb[dev].bsize);
   log_write(bp);
   brelse(bp);
 }
 
 // Blocks.
 
-// Allocate a zeroed disk block.
+#define BINUSE(map, bi) ((map)[(bi)/8] & (1 << ((bi) % 8)))
+
+// The number of free blocks among the first n of a bitmap block.
+static int
+bcount(uchar *map, int n)
+{
+  uint64 *w = (uint64*)map;
+  int bi, nfree = 0;
+
+  for(bi = 0; bi < n; bi++){
+    if(bi % 64 == 0 && bi + 64 <= n && (w[bi/64] == BFULL || w[bi/64] == 0)){
+      nfree += w[bi/64] ? 0 : 64;
+      bi += 63;
+    } else if(!BINUSE(map, bi)){
+      nfree++;
+    }
+  }
+  return nfree;
+}
+
+// The first block from..to-1 of a bitmap block that starts a free
+// run of at least run blocks, or -1. *first is set to the first free
+// block seen, if it is still -1.
+static int
+bfind(uchar *map, int from, int to, int run, int *first)
+{
+  uint64 *w = (uint64*)map;
+  int bi, n;
+
+  for(bi = from; bi < to; bi += n){
+    if(bi % 64 == 0 && w[bi/64] == BFULL){
+      n = 64;
+      continue;
+    }
+    n = 1;
+    if(BINUSE(map, bi))
+      continue;
+    while(n < run && bi + n < to && !BINUSE(map, bi + n))
+      n++;
+    if(*first < 0)
+      *first = bi;
+    if(n == run)
+      return bi;
+  }
+  return -1;
+}
+
+// Mark block b of bitmap block bp in use.
+static void
+bmark(uint dev, struct buf *bp, uint b)
+{
+  uint g = b / BPB(sb[dev]), bi = b % BPB(sb[dev]);
+
+  bp->data[bi/8] |= 1 << (bi % 8);
+  log_write(bp);
+  if(g < NBGROUP && alloc[dev].nfree[g] > 0)
+    alloc[dev].nfree[g]--;
+}
+
+// Allocate block b if it is free; else return 0. The block is
+// zeroed unless zero is 0, for a caller that fills all of it.
+// Lets a growing file stay in one extent.
 static uint
-balloc(uint dev)
+balloc_at(uint dev, uint b, int zero)
 {
-  int b, bi, m;
   struct buf *bp;
 
-  bp = 0;
-  for(b = 0; b < sb.size; b += BPB){
-    bp = bread(dev, BBLOCK(b, sb));
-    for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
-      m = 1 << (bi % 8);
-      if((bp->data[bi/8] & m) == 0){  // Is block free?
-        bp->data[bi/8] |= m;  // Mark block in use.
-        log_write(bp);
+  if(b == 0 || b >= sb[dev].size)
+    return 0;
+  bp = bread(dev, BBLOCK(b, sb[dev]));
+  if(BINUSE(bp->data, b % BPB(sb[dev]))){
+    brelse(bp);
+    return 0;
+  }
+  bmark(dev, bp, b);
+  brelse(bp);
+  if(zero)
+    bzero(dev, b);
+  return b;
+}
+
+// Allocate a disk block, zeroed unless zero is 0. A file that starts
+// a new extent asks for run > 1: the block is then taken, if there
+// is one, from the start of run free blocks, and the next search
+// starts after them, leaving the rest for the file to grow into.
+static uint
+balloc(uint dev, int run, int zero)
+{
+  struct buf *bp;
+  uint g, ng, start, from, to, i, bpb = BPB(sb[dev]);
+  int bi, first, any;
+
+  ng = (sb[dev].size + bpb - 1) / bpb;
+  for(;;){
+    start = alloc[dev].next < sb[dev].size ? alloc[dev].next : 0;
+    any = 0;
+    // the group start is in, from start on, then the others, then
+    // the start group up to start
+    for(i = 0; i <= ng; i++){
+      g = (start / bpb + i) % ng;
+      from = i == 0 ? start % bpb : 0;
+      to = i == ng ? start % bpb : min(bpb, sb[dev].size - g * bpb);
+      if(from >= to || (g < NBGROUP && alloc[dev].nfree[g] == 0))
+        continue;
+      bp = bread(dev, sb[dev].bmapstart + g);
+      if(g < NBGROUP && alloc[dev].nfree[g] < 0)
+        alloc[dev].nfree[g] = bcount(bp->data, min(bpb, sb[dev].size - g * bpb));
+      first = -1;
+      if((bi = bfind(bp->data, from, to, run, &first)) >= 0){
+        bmark(dev, bp, g * bpb + bi);
         brelse(bp);
-        bzero(dev, b + bi);
-        return b + bi;
+        alloc[dev].next = g * bpb + bi + run;
+        if(zero)
+          bzero(dev, g * bpb + bi);
+        return g * bpb + bi;
       }
+      brelse(bp);
+      if(any == 0 && first >= 0)
+        any = g * bpb + first;
+    }
+    // no run that long: the first free block, if nobody has taken
+    // it meanwhile
+    if(any == 0)
+      panic("balloc: out of blocks");
+    if(balloc_at(dev, any, zero)){
+      alloc[dev].next = any + 1;
+      return any;
     }
-    brelse(bp);
   }
-  panic("balloc: out of blocks");
 }
 
 // Free a disk block.
@@ -90,15 +225,18 @@ static void
 bfree(int dev, uint b)
 {
   struct buf *bp;
+  uint g = b / BPB(sb[dev]);
   int bi, m;
 
-  bp = bread(dev, BBLOCK(b, sb));
-  bi = b % BPB;
+  bp = bread(dev, BBLOCK(b, sb[dev]));
+  bi = b % BPB(sb[dev]);
   m = 1 << (bi % 8);
   if((bp->data[bi/8] & m) == 0)
     panic("freeing free block");
   bp->data[bi/8] &= ~m;
   log_write(bp);
+  if(g < NBGROUP && alloc[dev].nfree[g] >= 0)
+    alloc[dev].nfree[g]++;
   brelse(bp);
 }
 
@@ -176,6 +314,12 @@ struct {
   struct inode inode[NINODE];
 } itable;
 
+// The directory each disk other than ROOTDEV is mounted on, holding
+// a reference to it. A disk is never unmounted, so namex() reads
+// these without mountlock, which only keeps two mounts apart.
+static struct inode *mounton[NDISK];
+static struct sleeplock mountlock;
+
 void
 iinit()
 {
@@ -185,6 +329,7 @@ iinit()
   for(i = 0; i < NINODE; i++) {
     initsleeplock(&itable.inode[i].lock, "inode");
   }
+  initsleeplock(&mountlock, "mount");
 }
 
 static struct inode* iget(uint dev, uint inum);
@@ -199,9 +344,9 @@ ialloc(uint dev, short type)
   struct buf *bp;
   struct dinode *dip;
 
-  for(inum = 1; inum < sb.ninodes; inum++){
-    bp = bread(dev, IBLOCK(inum, sb));
-    dip = (struct dinode*)bp->data + inum%IPB;
+  for(inum = 1; inum < sb[dev].ninodes; inum++){
+    bp = bread(dev, IBLOCK(inum, sb[dev]));
+    dip = (struct dinode*)bp->data + inum%IPB(sb[dev]);
     if(dip->type == 0){  // a free inode
       memset(dip, 0, sizeof(*dip));
       dip->type = type;
@@ -224,14 +369,17 @@ iupdate(struct inode *ip)
   struct buf *bp;
   struct dinode *dip;
 
-  bp = bread(ip->dev, IBLOCK(ip->inum, sb));
-  dip = (struct dinode*)bp->data + ip->inum%IPB;
+  bp = bread(ip->dev, IBLOCK(ip->inum, sb[ip->dev]));
+  dip = (struct dinode*)bp->data + ip->inum%IPB(sb[ip->dev]);
   dip->type = ip->type;
   dip->major = ip->major;
   dip->minor = ip->minor;
   dip->nlink = ip->nlink;
   dip->size = ip->size;
-  memmove(dip->addrs, ip->addrs, sizeof(ip->addrs));
+  dip->nextent = ip->nextent;
+  memmove(dip->ext, ip->ext, sizeof(ip->ext));
+  dip->indirect = ip->indirect;
+  dip->dindirect = ip->dindirect;
   log_write(bp);
   brelse(bp);
 }
@@ -267,6 +415,7 @@ iget(uint dev, uint inum)
   ip->inum = inum;
   ip->ref = 1;
   ip->valid = 0;
+  ip->ra_next = ip->ra_end = ip->ra_win = 0;
   release(&itable.lock);
 
   return ip;
@@ -297,14 +446,17 @@ ilock(struct inode *ip)
   acquiresleep(&ip->lock);
 
   if(ip->valid == 0){
-    bp = bread(ip->dev, IBLOCK(ip->inum, sb));
-    dip = (struct dinode*)bp->data + ip->inum%IPB;
+    bp = bread(ip->dev, IBLOCK(ip->inum, sb[ip->dev]));
+    dip = (struct dinode*)bp->data + ip->inum%IPB(sb[ip->dev]);
     ip->type = dip->type;
     ip->major = dip->major;
     ip->minor = dip->minor;
     ip->nlink = dip->nlink;
     ip->size = dip->size;
-    memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
+    ip->nextent = dip->nextent;
+    memmove(ip->ext, dip->ext, sizeof(ip->ext));
+    ip->indirect = dip->indirect;
+    ip->dindirect = dip->dindirect;
     brelse(bp);
     ip->valid = 1;
     if(ip->type == 0)
@@ -368,68 +520,131 @@ iunlockput(struct inode *ip)
 // Inode content
 //
 // The content (data) associated with each inode is stored
-// in blocks on the disk. The first NDIRECT block numbers
-// are listed in ip->addrs[].  The next NINDIRECT blocks are
-// listed in block ip->addrs[NDIRECT].
+// in blocks on the disk. The first blocks are in up to NEXTENT
+// extents, ip->ext[], each a run of blocks that follow one
+// another on the disk, so that a file written in one go maps in
+// a few entries without reading any block. A file grows its last
+// extent while the block after it is free, and starts a new one
+// otherwise. Once the extents are used up, the blocks after them
+// are listed in block ip->indirect, and after those NINDIRECT
+// in the blocks listed in block ip->dindirect.
+
+// Return entry i of indirect block addr, allocating a block for
+// it if there is none, as bmap does.
+static uint
+ientry(struct inode *ip, uint addr, uint i, int *fresh)
+{
+  uint *a, b;
+  struct buf *bp;
+
+  bp = bread(ip->dev, addr);
+  a = (uint*)bp->data;
+  if((b = a[i]) == 0){
+    a[i] = b = balloc(ip->dev, 1, fresh == 0);
+    if(fresh)
+      *fresh = 1;
+    log_write(bp);
+  }
+  brelse(bp);
+  return b;
+}
 
 // Return the disk block address of the nth block in inode ip.
-// If there is no such block, bmap allocates one.
+// If there is no such block, bmap allocates one, zeroed unless
+// fresh is not 0: then it is left as it is on the disk and *fresh
+// set, for a caller that fills all of it.
 static uint
-bmap(struct inode *ip, uint bn)
+bmap(struct inode *ip, uint bn, int *fresh)
 {
-  uint addr, *a;
-  struct buf *bp;
+  uint addr, i;
+  struct extent *e;
+
+  for(i = 0; i < ip->nextent; i++){
+    e = &ip->ext[i];
+    if(bn < e->len)
+      return e->start + bn;
+    bn -= e->len;
+  }
 
-  if(bn < NDIRECT){
-    if((addr = ip->addrs[bn]) == 0)
-      ip->addrs[bn] = addr = balloc(ip->dev);
-    return addr;
+  // Append to the extents while the indirect blocks are unused.
+  if(bn == 0 && ip->indirect == 0 && ip->dindirect == 0){
+    e = ip->nextent > 0 ? &ip->ext[ip->nextent-1] : 0;
+    if(e && (addr = balloc_at(ip->dev, e->start + e->len, fresh == 0)) != 0){
+      e->len++;
+      if(fresh)
+        *fresh = 1;
+      return addr;
+    }
+    if(ip->nextent < NEXTENT){
+      e = &ip->ext[ip->nextent++];
+      e->start = balloc(ip->dev, NPREALLOC, fresh == 0);
+      e->len = 1;
+      if(fresh)
+        *fresh = 1;
+      return e->start;
+    }
   }
-  bn -= NDIRECT;
 
-  if(bn < NINDIRECT){
+  if(bn < NINDIRECT(sb[ip->dev])){
     // Load indirect block, allocating if necessary.
-    if((addr = ip->addrs[NDIRECT]) == 0)
-      ip->addrs[NDIRECT] = addr = balloc(ip->dev);
-    bp = bread(ip->dev, addr);
-    a = (uint*)bp->data;
-    if((addr = a[bn]) == 0){
-      a[bn] = addr = balloc(ip->dev);
-      log_write(bp);
-    }
-    brelse(bp);
-    return addr;
+    if(ip->indirect == 0)
+      ip->indirect = balloc(ip->dev, 1, 1);
+    return ientry(ip, ip->indirect, bn, fresh);
+  }
+  bn -= NINDIRECT(sb[ip->dev]);
+
+  if(bn < NINDIRECT(sb[ip->dev])*NINDIRECT(sb[ip->dev])){
+    if(ip->dindirect == 0)
+      ip->dindirect = balloc(ip->dev, 1, 1);
+    addr = ientry(ip, ip->dindirect, bn / NINDIRECT(sb[ip->dev]), 0);
+    return ientry(ip, addr, bn % NINDIRECT(sb[ip->dev]), fresh);
   }
 
   panic("bmap: out of range");
 }
 
+// Free indirect block addr and the blocks it lists, down depth
+// more levels of indirect blocks.
+static void
+ifree(struct inode *ip, uint addr, int depth)
+{
+  struct buf *bp;
+  uint *a;
+  int j;
+
+  bp = bread(ip->dev, addr);
+  a = (uint*)bp->data;
+  for(j = 0; j < NINDIRECT(sb[ip->dev]); j++){
+    if(a[j] == 0)
+      continue;
+    if(depth > 0)
+      ifree(ip, a[j], depth - 1);
+    else
+      bfree(ip->dev, a[j]);
+  }
+  brelse(bp);
+  bfree(ip->dev, addr);
+}
+
 // Truncate inode (discard contents).
 // Caller must hold ip->lock.
 void
 itrunc(struct inode *ip)
 {
-  int i, j;
-  struct buf *bp;
-  uint *a;
+  uint i, j;
 
-  for(i = 0; i < NDIRECT; i++){
-    if(ip->addrs[i]){
-      bfree(ip->dev, ip->addrs[i]);
-      ip->addrs[i] = 0;
-    }
-  }
+  for(i = 0; i < ip->nextent; i++)
+    for(j = 0; j < ip->ext[i].len; j++)
+      bfree(ip->dev, ip->ext[i].start + j);
+  ip->nextent = 0;
 
-  if(ip->addrs[NDIRECT]){
-    bp = bread(ip->dev, ip->addrs[NDIRECT]);
-    a = (uint*)bp->data;
-    for(j = 0; j < NINDIRECT; j++){
-      if(a[j])
-        bfree(ip->dev, a[j]);
-    }
-    brelse(bp);
-    bfree(ip->dev, ip->addrs[NDIRECT]);
-    ip->addrs[NDIRECT] = 0;
+  if(ip->indirect){
+    ifree(ip, ip->indirect, 0);
+    ip->indirect = 0;
+  }
+  if(ip->dindirect){
+    ifree(ip, ip->dindirect, 1);
+    ip->dindirect = 0;
   }
 
   ip->size = 0;
@@ -448,6 +663,36 @@ stati(struct inode *ip, struct stat *st)
   st->size = ip->size;
 }
 
+// Start reading the blocks after a sequential read of blocks
+// first..last, so that the next read finds them in the cache. The
+// window doubles each time the reads go on into a new block, up to
+// NBATCH blocks; a read anywhere else resets it.
+// Caller must hold ip->lock.
+static void
+readahead(struct inode *ip, uint first, uint last)
+{
+  uint bn[NBATCH], b, end, bsize = sb[ip->dev].bsize;
+  int n = 0;
+
+  if(first != ip->ra_next && first + 1 != ip->ra_next){
+    ip->ra_win = 0;
+    ip->ra_end = 0;
+  } else if(ip->ra_win == 0 || last >= ip->ra_next){
+    ip->ra_win = ip->ra_win ? min(2 * ip->ra_win, NBATCH) : 1;
+  }
+  ip->ra_next = last + 1;
+  if(ip->ra_win == 0)
+    return;
+
+  end = min(last + 1 + ip->ra_win, (ip->size + bsize - 1) / bsize);
+  for(b = max(last + 1, ip->ra_end); b < end; b++)
+    bn[n++] = bmap(ip, b, 0);
+  if(n > 0){
+    bprefetch(ip->dev, bn, n);
+    ip->ra_end = end;
+  }
+}
+
 // Read data from inode.
 // Caller must hold ip->lock.
 // If user_dst==1, then dst is a user virtual address;
@@ -455,27 +700,72 @@ stati(struct inode *ip, struct stat *st)
 int
 readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 {
-  uint tot, m;
-  struct buf *bp;
+  uint tot, m, bn[NBATCH], first, bsize = sb[ip->dev].bsize;
+  struct buf *bp[NBATCH];
+  int i, nb, direct = 0, err = 0;
 
   if(off > ip->size || off + n < off)
     return 0;
   if(off + n > ip->size)
     n = ip->size - off;
+  if(n == 0)
+    return 0;
+  first = off/bsize;
+
+  // the blocks of up to NBATCH at a time are requested together
+  for(tot=0; tot<n; ){
+    nb = min((off + n - tot - 1)/bsize - off/bsize + 1, NBATCH);
+    for(i = 0; i < nb; i++)
+      bn[i] = bmap(ip, off/bsize + i, 0);
+
+    // Whole blocks that are not cached go straight from the disk to
+    // user memory. ip->lock keeps anyone from caching and changing
+    // them meanwhile.
+    for(i = 0; user_dst && off%bsize == 0 && n - tot >= (i+1)*bsize && i < nb; i++)
+      if(bcached(ip->dev, bn[i]))
+        break;
+    if(i > 0){
+      if(bread_user(ip->dev, bn, i, myproc()->pagetable, dst) < 0)
+        return -1;
+      tot += i*bsize;
+      off += i*bsize;
+      dst += i*bsize;
+      direct = 1;
+      continue;
+    }
 
-  for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
-    m = min(n - tot, BSIZE - off%BSIZE);
-    if(either_copyout(user_dst, dst, bp->data + (off % BSIZE), m) == -1) {
-      brelse(bp);
-      tot = -1;
-      break;
+    // The rest go through the cache, up to the next block that
+    // could go straight.
+    for(i = 1; user_dst && i < nb; i++)
+      if((off/bsize + i + 1)*bsize <= off + n - tot && !bcached(ip->dev, bn[i]))
+        break;
+    nb = i;
+    bread_many(ip->dev, bn, nb, bp);
+    for(i = 0; i < nb; i++){
+      m = min(n - tot, bsize - off%bsize);
+      if(!err && either_copyout(user_dst, dst, bp[i]->data + (off % bsize), m) == -1)
+        err = 1;
+      tot += m;
+      off += m;
+      dst += m;
+      brelse(bp[i]);
     }
-    brelse(bp);
+    if(err)
+      return -1;
   }
+  // large reads that bypass the cache batch their own blocks
+  if(!direct)
+    readahead(ip, first, (off - 1)/bsize);
   return tot;
 }
 
+// The largest size of a file on dev, in bytes.
+uint
+maxsize(int dev)
+{
+  return MAXFILE(sb[dev]) * sb[dev].bsize;
+}
+
 // Write data to inode.
 // Caller must hold ip->lock.
 // If user_src==1, then src is a user virtual address;
@@ -486,18 +776,26 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 int
 writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
 {
-  uint tot, m;
+  uint tot, m, addr, bsize = sb[ip->dev].bsize;
   struct buf *bp;
+  int fresh;
 
   if(off > ip->size || off + n < off)
     return -1;
-  if(off + n > MAXFILE*BSIZE)
+  if(off + n > maxsize(ip->dev))
     return -1;
 
   for(tot=0; tot<n; tot+=m, off+=m, src+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
-    m = min(n - tot, BSIZE - off%BSIZE);
-    if(either_copyin(bp->data + (off % BSIZE), user_src, src, m) == -1) {
+    m = min(n - tot, bsize - off%bsize);
+    // A new block that the write fills is neither zeroed nor read.
+    fresh = 0;
+    addr = bmap(ip, off/bsize, m == bsize ? &fresh : 0);
+    bp = fresh ? bclaim(ip->dev, addr) : bread(ip->dev, addr);
+    if(either_copyin(bp->data + (off % bsize), user_src, src, m) == -1) {
+      if(fresh){
+        memset(bp->data, 0, bsize);
+        log_write(bp);
+      }
       brelse(bp);
       break;
     }
@@ -510,7 +808,7 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
 
   // write the i-node back to disk even if the size didn't change
   // because the loop above might have called bmap() and added a new
-  // block to ip->addrs[].
+  // block to ip->ext[].
   iupdate(ip);
 
   return tot;
@@ -621,10 +919,81 @@ skipelem(char *path, char *name)
   return path;
 }
 
+// Mounts.
+
+// Is ip a directory some disk is mounted on?
+int
+mountpoint(struct inode *ip)
+{
+  int dev;
+
+  for(dev = 0; dev < NDISK; dev++)
+    if(mounton[dev] == ip)
+      return 1;
+  return 0;
+}
+
+// Mount the file system of disk dev on the directory ip, which the
+// caller holds locked and which must be on a disk before dev, so
+// that a path takes the logs of the disks it crosses in order (see
+// log.c). Paths through ip lead to the root of dev from then on,
+// and dev gets its own log. Returns -1 if dev is missing, already
+// mounted or holds no file system.
+int
+mount(int dev, struct inode *ip)
+{
+  int r = -1;
+
+  if(dev < 0 || dev >= NDISK || dev <= ip->dev)
+    return -1;
+  if(ip->type != T_DIR || ip->inum == ROOTINO)
+    return -1;
+  acquiresleep(&mountlock);
+  if(mounton[dev] == 0 && !mountpoint(ip) &&
+     virtio_disk_init(dev) == 0 && fsinit(dev) == 0){
+    mounton[dev] = idup(ip);
+    r = 0;
+  }
+  releasesleep(&mountlock);
+  return r;
+}
+
+// If a disk is mounted on ip, put ip and return that disk's root,
+// joining the disk's transaction.
+static struct inode*
+crossmount(struct inode *ip)
+{
+  int dev;
+
+  for(dev = 0; dev < NDISK; dev++){
+    if(mounton[dev] == ip){
+      join_op(dev);
+      iput(ip);
+      return iget(dev, ROOTINO);
+    }
+  }
+  return ip;
+}
+
+// The disk a path name starts on, for begin_pathop(), or ANYDISK
+// if it may climb out of a mounted disk with "..".
+int
+pathdisk(char *path)
+{
+  int dev = *path == '/' ? ROOTDEV : myproc()->cwd->dev;
+  char *s;
+
+  for(s = path; dev != ROOTDEV && *s; s++)
+    if(s[0] == '.' && s[1] == '.')
+      return ANYDISK;
+  return dev;
+}
+
 // Look up and return the inode for a path name.
 // If parent != 0, return the inode for the parent and copy the final
 // path element into name, which must have room for DIRSIZ bytes.
-// Must be called inside a transaction since it calls iput().
+// Must be called inside a path transaction (begin_pathop()) since it
+// calls iput() and joins the transactions of the disks it crosses.
 static struct inode*
 namex(char *path, int nameiparent, char *name)
 {
@@ -646,12 +1015,20 @@ namex(char *path, int nameiparent, char *name)
       iunlock(ip);
       return ip;
     }
+    if(ip->dev != ROOTDEV && ip->inum == ROOTINO && namecmp(name, "..") == 0){
+      // .. of a mounted root is the parent of the mount point.
+      next = idup(mounton[ip->dev]);
+      join_op(next->dev);
+      iunlockput(ip);
+      ip = next;
+      ilock(ip);
+    }
     if((next = dirlookup(ip, name, 0)) == 0){
       iunlockput(ip);
       return 0;
     }
     iunlockput(ip);
-    ip = next;
+    ip = crossmount(next);
   }
   if(nameiparent){
     iput(ip);
@@ -3,15 +3,18 @@
 
 
 #define ROOTINO  1   // root i-number
-//#define BSIZE 2048  // block size
-#define BSIZE 65536  // block size
+#define MINBSIZE 1024   // smallest block size
+#define MAXBSIZE 65536  // largest block size
+#define BSIZE 65536     // block size mkfs makes by default
 
 // Disk layout:
 // [ boot block | super block | log | inode blocks |
 //                                          free bit map | data blocks]
 //
 // mkfs computes the super block and builds an initial file system. The
-// super block describes the disk layout:
+// super block describes the disk layout. It is at the start of
+// block 1 whatever the block size, which the kernel finds by
+// looking for it at each size in turn.
 struct superblock {
   uint magic;        // Must be FSMAGIC
   uint size;         // Size of file system image (blocks)
@@ -21,13 +24,24 @@ struct superblock {
   uint logstart;     // Block number of first log block
   uint inodestart;   // Block number of first inode block
   uint bmapstart;    // Block number of first free map block
+  uint bsize;        // Block size, a power of 2 from MINBSIZE to MAXBSIZE
 };
 
 #define FSMAGIC 0x10203040
 
-#define NDIRECT 12
-#define NINDIRECT (BSIZE / sizeof(uint))
-#define MAXFILE (NDIRECT + NINDIRECT)
+#define NEXTENT 13
+#define NINDIRECT(sb) ((sb).bsize / sizeof(uint))
+// # of blocks bmap reaches however fragmented the file, and # of
+// blocks a uint size reaches; a file has at most the fewer of them
+#define NMAPPED(sb) (NEXTENT + NINDIRECT(sb) + NINDIRECT(sb)*NINDIRECT(sb))
+#define MAXFILE(sb) (NMAPPED(sb) < 0xffffffffU / (sb).bsize ? \
+                     NMAPPED(sb) : 0xffffffffU / (sb).bsize)
+
+// len blocks from block start on
+struct extent {
+  uint start;
+  uint len;
+};
 
 // On-disk inode structure
 struct dinode {
@@ -36,20 +50,23 @@ struct dinode {
   short minor;          // Minor device number (T_DEVICE only)
   short nlink;          // Number of links to inode in file system
   uint size;            // Size of file (bytes)
-  uint addrs[NDIRECT+1];   // Data block addresses
+  uint nextent;         // # of ext[] in use
+  struct extent ext[NEXTENT];  // first data blocks, in file order
+  uint indirect;        // data blocks after the extents
+  uint dindirect;       // then blocks of those
 };
 
 // Inodes per block.
-#define IPB           (BSIZE / sizeof(struct dinode))
+#define IPB(sb)       ((sb).bsize / sizeof(struct dinode))
 
 // Block containing inode i
-#define IBLOCK(i, sb)     ((i) / IPB + sb.inodestart)
+#define IBLOCK(i, sb)     ((i) / IPB(sb) + (sb).inodestart)
 
 // Bitmap bits per block
-#define BPB           (BSIZE*8)
+#define BPB(sb)       ((sb).bsize*8)
 
 // Block of free map containing bit for block b
-#define BBLOCK(b, sb) ((b)/BPB + sb.bmapstart)
+#define BBLOCK(b, sb) ((b)/BPB(sb) + (sb).bmapstart)
 
 // Directory is a file containing a sequence of dirent structures.
 #define DIRSIZ 14
@@ -68,9 +68,12 @@ kfree(void *pa)
 // Allocate one 4096-byte page of physical memory.
 // Returns a pointer that the kernel can use.
 // Returns 0 if the memory cannot be allocated.
+// When memory runs out, the buffer cache gives some back.
 void *
 kalloc(void)
 {
+    void *p;
+
 //  struct run *r;
 //
 //  acquire(&kmem.lock);
@@ -82,5 +85,7 @@ kalloc(void)
 //  if(r)
 //    memset((char*)r, 5, PGSIZE); // fill with junk
 //  return (void*)r;
-    return bd_malloc(PGSIZE);
+    if((p = bd_malloc(PGSIZE)) == 0 && bshrink(BSHRINK) > 0)
+        p = bd_malloc(PGSIZE);
+    return p;
 }
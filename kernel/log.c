@@ -3,6 +3,7 @@
 #include "defs.h"
 #include "param.h"
 #include "spinlock.h"
+#include "proc.h"
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
@@ -15,8 +16,15 @@
 // any reasoning required about whether a commit might
 // write an uncommitted system call's updates to disk.
 //
-// A system call should call begin_op()/end_op() to mark
-// its start and end. Usually begin_op() just increments
+// Each disk has its own log. A system call should call
+// begin_op()/end_op() to mark its start and end, with the disk it
+// changes. One that goes by path name calls begin_pathop() with the
+// disk the path starts on instead, and namex() has it join the
+// transaction of each disk the path crosses into; end_pathop() ends
+// them all. A disk is mounted only on a directory of a disk before
+// it, so crossing in takes the logs in increasing order of disk.
+// A path that might climb back out with ".." starts on every disk
+// (ANYDISK) in that order. Usually begin_op() just increments
 // the count of in-progress FS system calls and returns.
 // But if it thinks the log is close to running out, it
 // sleeps until the last outstanding end_op() commits.
@@ -28,13 +36,23 @@
 //   block B
 //   block C
 //   ...
-// Log appends are synchronous.
+// The header carries a checksum of itself and of the logged blocks,
+// so the log blocks and the header go to the disk in one batch: a
+// header that lands without all of its blocks does not match them,
+// and recovery leaves it alone. Nor is the header erased once the
+// blocks are installed; installing them again does no harm, and the
+// next commit's blocks spoil its checksum.
+//
+// A commit that several processes' calls went into waits for one
+// yield() first, so that those about to start another call can join
+// it rather than wait for it and commit alone.
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
 struct logheader {
     int n;
     int block[LOGSIZE];
+    uint64 sum;
 };
 
 struct log {
@@ -43,82 +61,148 @@ struct log {
     int size;
     int outstanding; // how many FS sys calls are executing.
     int committing;  // in commit(), please wait.
+    int nop;         // FS sys calls in this transaction so far
     int dev;
+    uint bsize;
     struct logheader lh;
+    struct buf *bp[LOGSIZE];       // the cached, pinned blocks of lh
+    struct buf io[LOGSIZE], *iop[LOGSIZE];  // write requests of commit
 };
 struct log Log[NDISK];
 
 static void recover_from_log(int);
 static void commit(int);
 
+// FNV-1a over the n bytes at p, a word at a time.
+static uint64
+cksum(uint64 sum, void *p, int n)
+{
+    uint64 *w = p;
+    int i;
+
+    for (i = 0; i < n / 8; i++)
+        sum = (sum ^ w[i]) * 0x100000001b3ULL;
+    return sum;
+}
+
+// The checksum of a header, to go on with its blocks.
+static uint64
+headsum(struct logheader *lh)
+{
+    return cksum(0xcbf29ce484222325ULL, lh->block, sizeof(lh->block)) ^ lh->n;
+}
+
+// Write data[i] to block blockno[i], for i < n, in one batch of disk
+// requests and wait for them. The blocks go from wherever their data
+// is, whatever the cache holds for blockno.
+static void
+log_io(int dev, uint *blockno, uchar **data, int n)
+{
+    struct log *log = &Log[dev];
+    int i;
+
+    for (i = 0; i < n; i++) {
+        memset(&log->io[i], 0, sizeof(log->io[i]));
+        log->io[i].dev = dev;
+        log->io[i].blockno = blockno[i];
+        log->io[i].size = log->bsize;
+        log->io[i].data = data[i];
+        log->iop[i] = &log->io[i];
+    }
+    virtio_disk_start(dev, log->iop, n, 1);
+    for (i = 0; i < n; i++)
+        virtio_disk_wait(dev, log->iop[i]);
+}
+
+void
+loginit(void)
+{
+    int dev;
+
+    for (dev = 0; dev < NDISK; dev++)
+        initlock(&Log[dev].lock, "log");
+}
+
+// Set up the log of dev once its file system is found. Path calls
+// that started on every disk may be in progress on it meanwhile,
+// but none can have logged a block of it.
 void
 initlog(int dev, struct superblock *sb)
 {
-    if (sizeof(struct logheader) >= BSIZE)
+    if (sizeof(struct logheader) >= sb->bsize)
         panic("initlog: too big logheader");
 
-    initlock(&Log[dev].lock, "log");
     Log[dev].start = sb->logstart;
     Log[dev].size = sb->nlog;
     Log[dev].dev = dev;
+    Log[dev].bsize = sb->bsize;
     recover_from_log(dev);
 }
 
-// Copy committed blocks from log to their home location
+// Copy committed blocks to their home location: at commit from the
+// cache, all in one batch; when recovering from the log.
 static void
-install_trans(int dev)
+install_trans(int dev, int recovering)
 {
+    uint blockno[LOGSIZE];
+    uchar *data[LOGSIZE];
     int tail;
 
+    if (!recovering) {
+        for (tail = 0; tail < Log[dev].lh.n; tail++) {
+            blockno[tail] = Log[dev].lh.block[tail];
+            data[tail] = Log[dev].bp[tail]->data;
+        }
+        log_io(dev, blockno, data, Log[dev].lh.n);
+        for (tail = 0; tail < Log[dev].lh.n; tail++)
+            bunpin(Log[dev].bp[tail]);
+        return;
+    }
+
     for (tail = 0; tail < Log[dev].lh.n; tail++) {
         struct buf *lbuf = bread(dev, Log[dev].start + tail + 1); // read log block
         struct buf *dbuf = bread(dev, Log[dev].lh.block[tail]); // read dst
-        memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
+        memmove(dbuf->data, lbuf->data, Log[dev].bsize);  // copy block to dst
         bwrite(dbuf);  // write dst to disk
-        bunpin(dbuf);
         brelse(lbuf);
         brelse(dbuf);
     }
 }
 
-// Read the log header from disk into the in-memory log header
+// Read the log header from disk into the in-memory log header, and
+// check it against the log blocks. A header whose blocks did not all
+// reach the disk reads as an empty log.
 static void
 read_head(int dev)
 {
     struct buf *buf = bread(dev, Log[dev].start);
     struct logheader *lh = (struct logheader *) (buf->data);
+    struct buf *lbuf;
+    uint64 sum;
     int i;
-    Log[dev].lh.n = lh->n;
-    for (i = 0; i < Log[dev].lh.n; i++) {
-        Log[dev].lh.block[i] = lh->block[i];
-    }
-    brelse(buf);
-}
 
-// Write in-memory log header to disk.
-// This is the true point at which the
-// current transaction commits.
-static void
-write_head(int dev)
-{
-    struct buf *buf = bread(dev, Log[dev].start);
-    struct logheader *hb = (struct logheader *) (buf->data);
-    int i;
-    hb->n = Log[dev].lh.n;
+    Log[dev].lh = *lh;
+    brelse(buf);
+    if (Log[dev].lh.n <= 0 || Log[dev].lh.n >= Log[dev].size) {
+        Log[dev].lh.n = 0;
+        return;
+    }
+    sum = headsum(&Log[dev].lh);
     for (i = 0; i < Log[dev].lh.n; i++) {
-        hb->block[i] = Log[dev].lh.block[i];
+        lbuf = bread(dev, Log[dev].start + i + 1);
+        sum = cksum(sum, lbuf->data, Log[dev].bsize);
+        brelse(lbuf);
     }
-    bwrite(buf);
-    brelse(buf);
+    if (sum != Log[dev].lh.sum)
+        Log[dev].lh.n = 0;
 }
 
 static void
 recover_from_log(int dev)
 {
     read_head(dev);
-    install_trans(dev); // if committed, copy from log to disk
+    install_trans(dev, 1); // if committed, copy from log to disk
     Log[dev].lh.n = 0;
-    write_head(dev); // clear the log
 }
 
 // called at the start of each FS system call.
@@ -134,6 +218,7 @@ begin_op(int dev)
             sleep(&Log, &Log[dev].lock);
         } else {
             Log[dev].outstanding += 1;
+            Log[dev].nop += 1;
             release(&Log[dev].lock);
             break;
         }
@@ -151,7 +236,14 @@ end_op(int dev)
     Log[dev].outstanding -= 1;
     if(Log[dev].committing)
         panic("log[dev].committing");
-    if(Log[dev].outstanding == 0){
+    if(Log[dev].outstanding == 0 && Log[dev].nop > 1 && Log[dev].lh.n > 0){
+        // others may be about to join; let them
+        Log[dev].nop = 1;
+        release(&Log[dev].lock);
+        yield();
+        acquire(&Log[dev].lock);
+    }
+    if(Log[dev].outstanding == 0 && !Log[dev].committing){
         do_commit = 1;
         Log[dev].committing = 1;
     } else {
@@ -173,32 +265,80 @@ end_op(int dev)
     }
 }
 
-// Copy modified blocks from cache to log.
+// Start the transaction of a path system call on dev, the disk
+// its path starts on, or on every disk if dev is ANYDISK.
+void
+begin_pathop(int dev)
+{
+    myproc()->opdisks = 0;
+    if (dev != ANYDISK) {
+        join_op(dev);
+        return;
+    }
+    for (dev = 0; dev < NDISK; dev++)
+        join_op(dev);
+}
+
+// The path of this call has led to disk dev: take part in its
+// transaction too, if it does not yet.
+void
+join_op(int dev)
+{
+    struct proc *p = myproc();
+
+    if (p->opdisks & (1 << dev))
+        return;
+    begin_op(dev);
+    p->opdisks |= 1 << dev;
+}
+
+// End the transactions of a path system call, on each disk it has
+// taken part in.
+void
+end_pathop(void)
+{
+    struct proc *p = myproc();
+    int dev;
+
+    for (dev = NDISK - 1; dev >= 0; dev--)
+        if (p->opdisks & (1 << dev))
+            end_op(dev);
+    p->opdisks = 0;
+}
+
+// Write modified blocks from cache to log, and the header with
+// them. Once all are on the disk, the transaction is committed.
 static void
 write_log(int dev)
 {
+    struct buf *hbuf = bread(dev, Log[dev].start);
+    struct logheader *lh = &Log[dev].lh;
+    uint blockno[LOGSIZE];
+    uchar *data[LOGSIZE];
     int tail;
 
-    for (tail = 0; tail < Log[dev].lh.n; tail++) {
-        struct buf *to = bread(dev, Log[dev].start + tail + 1); // log block
-        struct buf *from = bread(dev, Log[dev].lh.block[tail]); // cache block
-        memmove(to->data, from->data, BSIZE);
-        bwrite(to);  // write the log
-        brelse(from);
-        brelse(to);
+    lh->sum = headsum(lh);
+    for (tail = 0; tail < lh->n; tail++) {
+        blockno[tail] = Log[dev].start + tail + 1;
+        data[tail] = Log[dev].bp[tail]->data;
+        lh->sum = cksum(lh->sum, data[tail], Log[dev].bsize);
     }
+    memmove(hbuf->data, lh, sizeof(*lh));
+    blockno[tail] = Log[dev].start;
+    data[tail] = hbuf->data;
+    log_io(dev, blockno, data, lh->n + 1);
+    brelse(hbuf);
 }
 
 static void
 commit(int dev)
 {
     if (Log[dev].lh.n > 0) {
-        write_log(dev);     // Write modified blocks from cache to log
-        write_head(dev);    // Write header to disk -- the real commit
-        install_trans(dev); // Now install writes to home locations
+        write_log(dev);        // Write log and header -- the real commit
+        install_trans(dev, 0); // Now install writes to home locations
         Log[dev].lh.n = 0;
-        write_head(dev);    // Erase the transaction from the log
     }
+    Log[dev].nop = 0;
 }
 
 // Caller has modified b->data and is done with the buffer.
@@ -229,6 +369,7 @@ log_write(struct buf *b)
     Log[dev].lh.block[i] = b->blockno;
     if (i == Log[dev].lh.n) {  // Add new block to log?
         bpin(b);
+        Log[dev].bp[i] = b;
         Log[dev].lh.n++;
     }
     release(&Log[dev].lock);
@@ -261,10 +402,8 @@ crash_op(int dev, int docommit)
         // call commit w/o holding locks, since not allowed
         // to sleep with locks.
 
-        if (Log[dev].lh.n > 0) {
-            write_log(dev);     // Write modified blocks from cache to log
-            write_head(dev);    // Write header to disk -- the real commit
-        }
+        if (Log[dev].lh.n > 0)
+            write_log(dev);     // Write log and header -- the real commit
     }
     panic("crashed file system; please restart xv6 and run crashtest\n");
 }
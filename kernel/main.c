@@ -30,11 +30,13 @@ main()
     plicinit();      // set up interrupt controller
     plicinithart();  // ask PLIC for device interrupts
     binit();         // buffer cache
+    loginit();       // log locks of each disk
     iinit();         // inode table
     fileinit();      // file table
     pci_init();      // init vga
     soundinit();     // init AC97
-    virtio_disk_init(minor(ROOTDEV)); // emulated hard disk
+    if(virtio_disk_init(minor(ROOTDEV)) < 0) // emulated hard disk
+      panic("could not find virtio disk");
     userinit();      // first user process
     __sync_synchronize();
     started = 1;
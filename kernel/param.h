@@ -8,8 +8,14 @@
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGSIZE      (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       2000  // size of file system in blocks
+#define NBATCH       4   // max # of blocks bread_many or readahead reads at once
+#define NBUF         (MAXOPBLOCKS*3+2*NBATCH)  // min size of disk block cache
+#define NBUFMAX      4096  // max size of disk block cache
+#define BSHRINK      16  // # of cache blocks given back when memory runs out
+#define NPREALLOC    16  // # of free blocks a new extent looks for to grow into
+#define FSSIZE       2000  // size of file system in BSIZE blocks
 #define MAXPATH      128   // maximum file path name
+#define LOCKSTAT     1     // count contended spinlock acquires for ntas()
 
-#define NDISK        2
\ No newline at end of file
+#define NDISK        2
+#define ANYDISK      (-1)  // begin_pathop() on every disk
@@ -49,33 +49,6 @@ printint(int xx, int base, int sign)
     consputc(buf[i]);
 }
 
-static void
-printdouble(double xx)
-{
-  char buf[16];
-  int i;
-  uint x;
-
-  x = (uint)(xx);
-  double y = xx - x;
-  i = 0;
-  do {
-    buf[i++] = digits[x % 10];
-  } while((x /= 10) != 0);
-  while(--i >= 0)
-    consputc(buf[i]);
-  consputc('.');
-  x = (uint)(y*10000.0);
-  i = 0;
-  do {
-    buf[i++] = digits[x % 10];
-  } while((x /= 10) != 0);
-  while(i < 4)
-    buf[i++] = digits[0];
-  while(--i >= 0)
-    consputc(buf[i]);
-}
-
 static void
 printptr(uint64 x)
 {
@@ -114,9 +87,6 @@ printf(char *fmt, ...)
     case 'd':
       printint(va_arg(ap, int), 10, 1);
       break;
-    case 'f':
-      printdouble(va_arg(ap, double));
-      break;
     case 'x':
       printint(va_arg(ap, int), 16, 1);
       break;
@@ -140,6 +140,7 @@ found:
   // Set up new context to start executing at forkret,
   // which returns to user space.
   memset(&p->context, 0, sizeof(p->context));
+  memset(&p->fpstate, 0, sizeof(p->fpstate));
   p->context.ra = (uint64)forkret;
   p->context.sp = p->kstack + PGSIZE;
 
@@ -263,6 +264,7 @@ growproc(int n)
       return -1;
     }
   } else if(n < 0){
+    audiorelease(p);
     sz = uvmdealloc(p->pagetable, sz, sz + n);
   }
   p->sz = sz;
@@ -293,6 +295,8 @@ fork(void)
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
+  fpsave(&p->fpstate);
+  np->fpstate = p->fpstate;
 
   // Cause fork to return 0 in the child.
   np->trapframe->a0 = 0;
@@ -354,10 +358,11 @@ exit(int status)
       p->ofile[fd] = 0;
     }
   }
+  audiorelease(p);
 
-  begin_op(ROOTDEV);
+  begin_pathop(pathdisk("."));  // the disk of the cwd
   iput(p->cwd);
-  end_op(ROOTDEV);
+  end_pathop();
   p->cwd = 0;
 
   acquire(&wait_lock);
@@ -456,7 +461,11 @@ scheduler(void)
         // before jumping back to us.
         p->state = RUNNING;
         c->proc = p;
+        fprestore(&p->fpstate);
+        w_sstatus((r_sstatus() & ~SSTATUS_FS) | SSTATUS_FS_CLEAN);
         swtch(&c->context, &p->context);
+        if((r_sstatus() & SSTATUS_FS) == SSTATUS_FS_DIRTY)
+          fpsave(&p->fpstate);
 
         // Process is done running for now.
         // It should have changed its p->state before coming back.
@@ -526,7 +535,8 @@ forkret(void)
     // regular process (e.g., because it calls sleep), and thus cannot
     // be run from main().
     first = 0;
-    fsinit(ROOTDEV);
+    if(fsinit(ROOTDEV) < 0)
+      panic("invalid file system");
   }
 
   usertrapret();
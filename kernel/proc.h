@@ -116,6 +116,14 @@ struct cbhandler {
     /* 296 */ uint64 epc;
 };
 
+// Floating-point registers of a user process, saved by the
+// scheduler when it switches away from a process that has
+// written them.
+struct fpstate {
+  uint64 f[32];
+  uint64 fcsr;
+};
+
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 // Per-process state
@@ -138,8 +146,10 @@ struct proc {
   pagetable_t pagetable;       // User page table
   struct trapframe *trapframe; // data page for trampoline.S
   struct context context;      // swtch() here to run process
+  struct fpstate fpstate;      // user floating-point registers
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
+  int opdisks;                 // disks whose log a path call is in
   char name[16];               // Process name (debugging)
 
     struct cbhandler cb;
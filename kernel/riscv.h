@@ -14,6 +14,7 @@ r_mhartid()
 #define MSTATUS_MPP_S (1L << 11)
 #define MSTATUS_MPP_U (0L << 11)
 #define MSTATUS_MIE (1L << 3)    // machine-mode interrupt enable.
+#define MSTATUS_FS_INITIAL (1L << 13) // turn the FPU on.
 
 static inline uint64
 r_mstatus()
@@ -45,6 +46,9 @@ w_mepc(uint64 x)
 #define SSTATUS_UPIE (1L << 4) // User Previous Interrupt Enable
 #define SSTATUS_SIE (1L << 1)  // Supervisor Interrupt Enable
 #define SSTATUS_UIE (1L << 0)  // User Interrupt Enable
+#define SSTATUS_FS (3L << 13)        // FPU state
+#define SSTATUS_FS_CLEAN (2L << 13)  // FPU registers match the saved copy
+#define SSTATUS_FS_DIRTY (3L << 13)  // FPU registers were written
 
 static inline uint64
 r_sstatus()
@@ -24,6 +24,13 @@ struct descriptor {
 
 static struct descriptor descriTable[DMA_BUF_NUM];
 
+// physical address of the i-th DMA chunk of node
+static uint chunkaddr(struct soundNode *node, int i) {
+    if (node->dma)
+        return node->dma[i];
+    return v2p(node->data) + i * DMA_BUF_SIZE;
+}
+
 ushort namba; // native audio mixer base address
 ushort nabmba; // native audio bus mastering base address
 
@@ -166,6 +173,7 @@ void soundInterrupt(void) {
     int flag = node->flag;
 
     node->flag |= PROCESSED;
+    wakeup(&soundQueue);
 
     //0 sound file left
     WriteRegShort(nabmba + 0x16, 0x1c);
@@ -177,7 +185,7 @@ void soundInterrupt(void) {
     //descriptor table buffer
     for (i = 0; i < DMA_BUF_NUM; i++)
     {
-        descriTable[i].buf = v2p(soundQueue->data) + i * DMA_BUF_SIZE;
+        descriTable[i].buf = chunkaddr(soundQueue, i);
         descriTable[i].cmd_len = 0x80000000 + DMA_SMP_NUM;
     }
 
@@ -195,7 +203,7 @@ void playSound(void) {
     //每个数据块大小: DMA_BUF_SIZE
     for (i = 0; i < DMA_BUF_NUM; i++)
     {
-        descriTable[i].buf = v2p(soundQueue->data) + i * DMA_BUF_SIZE;
+        descriTable[i].buf = chunkaddr(soundQueue, i);
         descriTable[i].cmd_len = 0x80000000 + DMA_SMP_NUM;
     }
 
@@ -233,3 +241,49 @@ void addSound(struct soundNode *node) {
 
     release(&soundLock);
 }
+
+// Producers sleep on &soundQueue; soundInterrupt() wakes them each
+// time a node has been played.
+
+// Sleep until the card has played node.
+void waitSound(struct soundNode *node) {
+    acquire(&soundLock);
+    while ((node->flag & PROCESSED) == 0 && !myproc()->killed)
+        sleep(&soundQueue, &soundLock);
+    release(&soundLock);
+}
+
+// Sleep until one of the n nodes is free, i.e. played or never
+// queued, and return its index; -1 if the process was killed.
+int waitFreeSound(struct soundNode *nodes, int n) {
+    int i;
+
+    acquire(&soundLock);
+    for (;;) {
+        for (i = 0; i < n; i++) {
+            if (nodes[i].flag & PROCESSED) {
+                release(&soundLock);
+                return i;
+            }
+        }
+        if (myproc()->killed)
+            break;
+        sleep(&soundQueue, &soundLock);
+    }
+    release(&soundLock);
+    return -1;
+}
+
+// Stop the DMA engine and drop everything queued, so that the
+// memory behind the nodes can be reused.
+void stopSound(void) {
+    struct soundNode *node;
+
+    acquire(&soundLock);
+    WriteRegByte(nabmba + 0x1B, 0x00); // pause, no interrupt
+    for (node = soundQueue; node; node = node->next)
+        node->flag |= PROCESSED;
+    soundQueue = 0;
+    wakeup(&soundQueue);
+    release(&soundLock);
+}
@@ -30,13 +30,26 @@ struct wav{
   uint dlen;
 };
 
+// One buffer descriptor list worth of PCM. The samples are either
+// in a kernel buffer (data) or in pinned user pages, in which case
+// dma[i] is the physical address of the i-th DMA_BUF_SIZE chunk.
 struct soundNode{
   volatile int flag;
   struct soundNode *next;
-  uchar data[DMA_BUF_NUM*DMA_BUF_SIZE];
+  uchar *data;
+  uint *dma;
 };
 
 void addSound(struct soundNode *node);
+void waitSound(struct soundNode *node);
+int waitFreeSound(struct soundNode *nodes, int n);
+void stopSound(void);
+
+// Zero-copy playback: audiopin() registers up to AUDIO_SLOTS slots
+// of AUDIO_SLOT_SIZE bytes of user memory, aligned to DMA_BUF_SIZE,
+// which the card then reads directly.
+#define AUDIO_SLOT_SIZE (DMA_BUF_NUM*DMA_BUF_SIZE)
+#define AUDIO_SLOTS 8
 
 #define PROCESSED  0x1
 #define PCM_OUT 0x2
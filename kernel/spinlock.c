@@ -16,6 +16,8 @@ initlock(struct spinlock *lk, char *name)
   lk->name = name;
   lk->locked = 0;
   lk->cpu = 0;
+  lk->n = 0;
+  lk->nts = 0;
 }
 
 // Acquire the lock.
@@ -31,8 +33,18 @@ acquire(struct spinlock *lk)
   //   a5 = 1
   //   s1 = &lk->locked
   //   amoswap.w.aq a5, a5, (s1)
-  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+  if(__sync_lock_test_and_set(&lk->locked, 1) != 0){
+    // Held: count, for ntas(), only here where the cpu waits anyway.
+#if LOCKSTAT
+    __sync_fetch_and_add(&lk->n, 1);
+#endif
+    while(__sync_lock_test_and_set(&lk->locked, 1) != 0){
+#if LOCKSTAT
+      __sync_fetch_and_add(&lk->nts, 1);
+      __sync_fetch_and_add(&ntest_and_set, 1);
+#endif
+    }
+  }
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
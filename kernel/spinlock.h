@@ -5,5 +5,9 @@ struct spinlock {
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
+
+  // For statistics:
+  uint n;            // # of acquires that found it held
+  uint nts;          // # of test-and-sets that found it held
 };
 
@@ -24,6 +24,11 @@ start()
   unsigned long x = r_mstatus();
   x &= ~MSTATUS_MPP_MASK;
   x |= MSTATUS_MPP_S;
+  // let user programs use floating point. The kernel has no
+  // floating-point code (printf has no %f), so it never disturbs
+  // the user's f-registers, which scheduler() saves only when a
+  // process leaves them dirty; see fpsave() in swtch.S.
+  x |= MSTATUS_FS_INITIAL;
   w_mstatus(x);
 
   // set M Exception Program Counter to main, for mret.
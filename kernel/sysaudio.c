@@ -7,6 +7,7 @@
 #include "proc.h"
 
 static struct soundNode audiobuf[3];
+static uchar audiodata[3][DMA_BUF_NUM*DMA_BUF_SIZE];
 int datacount;
 int bufcount;
 int audiosize; // new data size
@@ -27,6 +28,27 @@ struct decode {
 struct snd sndlock;
 struct decode decodelock, mp3lock;
 
+// user memory registered with audiopin()
+static struct {
+    struct spinlock lock;
+    struct proc *owner;
+    int nslot;
+    struct soundNode node[AUDIO_SLOTS];
+    uint dma[AUDIO_SLOTS][DMA_BUF_NUM];
+    int queue[AUDIO_SLOTS];  // submitted slots, oldest first
+    int head;
+    int count;
+} pin;
+
+//清空第i个soundNode
+static void
+clearbuf(int i)
+{
+    memset(audiodata[i], 0, sizeof(audiodata[i]));
+    memset(&audiobuf[i], 0, sizeof(struct soundNode));
+    audiobuf[i].data = audiodata[i];
+}
+
 
 int sys_setSampleRate(void)
 {
@@ -40,7 +62,7 @@ int sys_setSampleRate(void)
     //将soundNode清空并置为已处理状态
     for (i = 0; i < 3; i++)
     {
-        memset(&audiobuf[i], 0, sizeof(struct soundNode));
+        clearbuf(i);
         audiobuf[i].flag = PROCESSED;
     }
     //audio.c设置采样率
@@ -59,7 +81,7 @@ sys_wavdecode(void)
     }
     release(&decodelock.lock);
     if (datacount == 0)
-        memset(&audiobuf[bufcount], 0, sizeof(struct soundNode));
+        clearbuf(bufcount);
     //若soundNode的剩余大小大于数据大小，将数据写入soundNode中
     if (bufsize - datacount > audiosize) {
         memmove(&audiobuf[bufcount].data[datacount], buf, audiosize);
@@ -77,25 +99,22 @@ sys_wavdecode(void)
         audiobuf[bufcount].flag = PCM_OUT;
         addSound(&audiobuf[bufcount]);
         int flag = 1;
-        //寻找一个已经被处理的soundNode，将剩余数据戏写入
+        //等待声卡播放完一个soundNode(由中断唤醒)，将剩余数据写入
         while(flag == 1) {
-            for (i = 0; i < 3; ++i) {
-                if ((audiobuf[i].flag & PROCESSED) == PROCESSED) {
-                    memset(&audiobuf[i], 0, sizeof(struct soundNode));
-                    if (bufsize > audiosize - temp) {
-                        memmove(&audiobuf[i].data[0], (buf + temp), (audiosize - temp));
-                        audiobuf[i].flag = PCM_OUT | PROCESSED;
-                        datacount = audiosize - temp;
-                        bufcount = i;
-                        flag = -1;
-                        break;
-                    } else {
-                        memmove(&audiobuf[i].data[0], (buf + temp), bufsize);
-                        temp = temp + bufsize;
-                        audiobuf[i].flag = PCM_OUT;
-                        addSound(&audiobuf[i]);
-                    }
-                }
+            if ((i = waitFreeSound(audiobuf, 3)) < 0)
+                break;
+            clearbuf(i);
+            if (bufsize > audiosize - temp) {
+                memmove(&audiobuf[i].data[0], (buf + temp), (audiosize - temp));
+                audiobuf[i].flag = PCM_OUT | PROCESSED;
+                datacount = audiosize - temp;
+                bufcount = i;
+                flag = -1;
+            } else {
+                memmove(&audiobuf[i].data[0], (buf + temp), bufsize);
+                temp = temp + bufsize;
+                audiobuf[i].flag = PCM_OUT;
+                addSound(&audiobuf[i]);
             }
         }
     }
@@ -110,17 +129,22 @@ int
 sys_kwrite(void)
 {
     uint64 buffer;
+    int size;
     //获取待播放的数据和数据大小
+    if (argint(1, &size) < 0 || argaddr(0, &buffer) < 0 ||
+        size < 0 || size > sizeof(buf))
+        return -1;
     acquire(&decodelock.lock);
     while (isdecoding) {
  	    sleep(&decodelock.nwrite, &decodelock.lock);
     }
-    if (argint(1, &audiosize) < 0 || argaddr(0, &buffer) < 0)
-        return -1;
     struct proc *pr = myproc();
     //将解码后的数据从用户空间拷贝进内核空间
-    if(copyin(pr->pagetable, buf, buffer, audiosize) == -1)
+    if(copyin(pr->pagetable, buf, buffer, size) == -1) {
+        release(&decodelock.lock);
         return -1;
+    }
+    audiosize = size;
     isdecoding = 1;
     wakeup(&decodelock.nread);
     release(&decodelock.lock);
@@ -142,3 +166,111 @@ sys_pause(void)
     return 0;
 }
 
+
+// Stop playing from p's pinned buffers and forget them. Called when
+// the pages may go away: exit, exec, shrinking sbrk, or a new pin.
+void
+audiorelease(struct proc *p)
+{
+    acquire(&pin.lock);
+    if (pin.owner != p) {
+        release(&pin.lock);
+        return;
+    }
+    // all under pin.lock, so that a new owner starts from scratch
+    // and its sound is not the one stopped
+    if (pin.count > 0)
+        stopSound();
+    pin.nslot = 0;
+    pin.head = pin.count = 0;
+    pin.owner = 0;
+    release(&pin.lock);
+}
+
+// audiopin(buf, n): register n bytes at buf as n / AUDIO_SLOT_SIZE
+// playback slots and return their number. audiopin(0, 0) unpins.
+int
+sys_audiopin(void)
+{
+    uint64 va, a, pa;
+    int n, s, i;
+    struct proc *p = myproc();
+
+    if (argaddr(0, &va) < 0 || argint(1, &n) < 0)
+        return -1;
+    audiorelease(p);
+    if (n == 0)
+        return 0;
+    if (va % DMA_BUF_SIZE || n <= 0 || n % AUDIO_SLOT_SIZE ||
+        n > AUDIO_SLOTS * AUDIO_SLOT_SIZE || va + n > p->sz)
+        return -1;
+
+    acquire(&pin.lock);
+    if (pin.owner) {
+        release(&pin.lock);
+        return -1;
+    }
+    pin.owner = p;
+    release(&pin.lock);
+
+    // A chunk is DMA_BUF_SIZE-aligned so never crosses a page; the
+    // pages stay put until audiorelease().
+    pin.nslot = n / AUDIO_SLOT_SIZE;
+    for (s = 0; s < pin.nslot; s++) {
+        for (i = 0; i < DMA_BUF_NUM; i++) {
+            a = va + s * AUDIO_SLOT_SIZE + i * DMA_BUF_SIZE;
+            if ((pa = walkaddr(p->pagetable, a)) == 0) {
+                audiorelease(p);
+                return -1;
+            }
+            pin.dma[s][i] = pa + (a & (PGSIZE - 1));
+        }
+        pin.node[s].data = 0;
+        pin.node[s].dma = pin.dma[s];
+        pin.node[s].flag = PROCESSED;
+    }
+    pin.head = pin.count = 0;
+    return pin.nslot;
+}
+
+// audioqueue(slot): play a filled slot after those already queued.
+int
+sys_audioqueue(void)
+{
+    int slot;
+
+    if (argint(0, &slot) < 0)
+        return -1;
+    if (pin.owner != myproc() || slot < 0 || slot >= pin.nslot ||
+        (pin.node[slot].flag & PROCESSED) == 0 || pin.count == pin.nslot)
+        return -1;
+
+    acquire(&sndlock.lock);
+    while (ispaused == 1)
+        sleep(&sndlock.tag, &sndlock.lock);
+    release(&sndlock.lock);
+
+    pin.node[slot].flag = PCM_OUT;
+    pin.queue[(pin.head + pin.count) % AUDIO_SLOTS] = slot;
+    pin.count++;
+    addSound(&pin.node[slot]);
+    return 0;
+}
+
+// audiowait(): wait for the oldest queued slot to finish playing
+// and return it, free to be refilled. -1 if nothing is queued.
+int
+sys_audiowait(void)
+{
+    int slot;
+
+    if (pin.owner != myproc() || pin.count == 0)
+        return -1;
+    slot = pin.queue[pin.head];
+    waitSound(&pin.node[slot]);
+    if ((pin.node[slot].flag & PROCESSED) == 0)
+        return -1;      // killed
+    pin.head = (pin.head + 1) % AUDIO_SLOTS;
+    pin.count--;
+    return slot;
+}
@@ -120,6 +120,8 @@ extern uint64 sys_unlink(void);
 extern uint64 sys_wait(void);
 extern uint64 sys_write(void);
 extern uint64 sys_uptime(void);
+extern uint64 sys_lseek(void);
+extern uint64 sys_mount(void);
 
 extern uint64 sys_read_user(void);
 extern uint64 sys_write_user(void);
@@ -137,6 +139,9 @@ extern uint64 sys_kwrite(void);
 extern uint64 sys_setSampleRate(void);
 extern uint64 sys_pause(void);
 extern uint64 sys_wavdecode(void);
+extern uint64 sys_audiopin(void);
+extern uint64 sys_audioqueue(void);
+extern uint64 sys_audiowait(void);
 extern uint64 sys_beginDecode(void);
 extern uint64 sys_waitForDecode(void);
 extern uint64 sys_endDecode(void);
@@ -165,6 +170,8 @@ static uint64 (*syscalls[])(void) = {
 [SYS_link]    sys_link,
 [SYS_mkdir]   sys_mkdir,
 [SYS_close]   sys_close,
+[SYS_lseek]   sys_lseek,
+[SYS_mount]   sys_mount,
 
 [SYS_create_sem] sys_create_sem,
 [SYS_free_sem] sys_free_sem,
@@ -181,6 +188,10 @@ static uint64 (*syscalls[])(void) = {
 [SYS_setSampleRate] sys_setSampleRate,
 [SYS_pause]         sys_pause,
 [SYS_wavdecode]     sys_wavdecode,
+[SYS_audiopin]      sys_audiopin,
+[SYS_audioqueue]    sys_audioqueue,
+[SYS_audiowait]     sys_audiowait,
+[SYS_ntas]          sys_ntas,
 };
 
 void
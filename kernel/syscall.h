@@ -20,6 +20,8 @@
 #define SYS_link   19
 #define SYS_mkdir  20
 #define SYS_close  21
+#define SYS_lseek  22
+#define SYS_mount  23
 
 // System calls for semaphore
 
@@ -41,4 +43,8 @@
 #define SYS_kwrite 38
 #define SYS_setSampleRate 39
 #define SYS_pause 40
-#define SYS_wavdecode 41
\ No newline at end of file
+#define SYS_wavdecode 41
+#define SYS_audiopin 42
+#define SYS_audioqueue 43
+#define SYS_audiowait 44
+#define SYS_ntas 45
\ No newline at end of file
@@ -91,6 +91,17 @@ sys_write(void)
   return filewrite(f, p, n);
 }
 
+uint64
+sys_lseek(void)
+{
+  struct file *f;
+  int off, whence;
+
+  if(argfd(0, 0, &f) < 0 || argint(1, &off) < 0 || argint(2, &whence) < 0)
+    return -1;
+  return fileseek(f, off, whence);
+}
+
 uint64
 sys_close(void)
 {
@@ -121,20 +132,22 @@ sys_link(void)
 {
   char name[DIRSIZ], new[MAXPATH], old[MAXPATH];
   struct inode *dp, *ip;
+  int dev;
 
   if(argstr(0, old, MAXPATH) < 0 || argstr(1, new, MAXPATH) < 0)
     return -1;
 
-  begin_op(ROOTDEV);
+  dev = pathdisk(old);
+  begin_pathop(dev == pathdisk(new) ? dev : ANYDISK);
   if((ip = namei(old)) == 0){
-    end_op(ROOTDEV);
+    end_pathop();
     return -1;
   }
 
   ilock(ip);
   if(ip->type == T_DIR){
     iunlockput(ip);
-    end_op(ROOTDEV);
+    end_pathop();
     return -1;
   }
 
@@ -152,7 +165,7 @@ sys_link(void)
   iunlockput(dp);
   iput(ip);
 
-  end_op(ROOTDEV);
+  end_pathop();
 
   return 0;
 
@@ -161,7 +174,7 @@ bad:
   ip->nlink--;
   iupdate(ip);
   iunlockput(ip);
-  end_op(ROOTDEV);
+  end_pathop();
   return -1;
 }
 
@@ -192,9 +205,9 @@ sys_unlink(void)
   if(argstr(0, path, MAXPATH) < 0)
     return -1;
 
-  begin_op(ROOTDEV);
+  begin_pathop(pathdisk(path));
   if((dp = nameiparent(path, name)) == 0){
-    end_op(ROOTDEV);
+    end_pathop();
     return -1;
   }
 
@@ -210,7 +223,7 @@ sys_unlink(void)
 
   if(ip->nlink < 1)
     panic("unlink: nlink < 1");
-  if(ip->type == T_DIR && !isdirempty(ip)){
+  if(ip->type == T_DIR && (mountpoint(ip) || !isdirempty(ip))){
     iunlockput(ip);
     goto bad;
   }
@@ -228,13 +241,13 @@ sys_unlink(void)
   iupdate(ip);
   iunlockput(ip);
 
-  end_op(ROOTDEV);
+  end_pathop();
 
   return 0;
 
 bad:
   iunlockput(dp);
-  end_op(ROOTDEV);
+  end_pathop();
   return -1;
 }
 
@@ -295,30 +308,30 @@ sys_open(void)
   if((n = argstr(0, path, MAXPATH)) < 0 || argint(1, &omode) < 0)
     return -1;
 
-  begin_op(ROOTDEV);
+  begin_pathop(pathdisk(path));
 
   if(omode & O_CREATE){
     ip = create(path, T_FILE, 0, 0);
     if(ip == 0){
-      end_op(ROOTDEV);
+      end_pathop();
       return -1;
     }
   } else {
     if((ip = namei(path)) == 0){
-      end_op(ROOTDEV);
+      end_pathop();
       return -1;
     }
     ilock(ip);
     if(ip->type == T_DIR && omode != O_RDONLY){
       iunlockput(ip);
-      end_op(ROOTDEV);
+      end_pathop();
       return -1;
     }
   }
 
   if(ip->type == T_DEVICE && (ip->major < 0 || ip->major >= NDEV)){
     iunlockput(ip);
-    end_op(ROOTDEV);
+    end_pathop();
     return -1;
   }
 
@@ -326,7 +339,7 @@ sys_open(void)
     if(f)
       fileclose(f);
     iunlockput(ip);
-    end_op(ROOTDEV);
+    end_pathop();
     return -1;
   }
 
@@ -346,7 +359,7 @@ sys_open(void)
   }
 
   iunlock(ip);
-  end_op(ROOTDEV);
+  end_pathop();
 
   return fd;
 }
@@ -357,13 +370,15 @@ sys_mkdir(void)
   char path[MAXPATH];
   struct inode *ip;
 
-  begin_op(ROOTDEV);
-  if(argstr(0, path, MAXPATH) < 0 || (ip = create(path, T_DIR, 0, 0)) == 0){
-    end_op(ROOTDEV);
+  if(argstr(0, path, MAXPATH) < 0)
+    return -1;
+  begin_pathop(pathdisk(path));
+  if((ip = create(path, T_DIR, 0, 0)) == 0){
+    end_pathop();
     return -1;
   }
   iunlockput(ip);
-  end_op(ROOTDEV);
+  end_pathop();
   return 0;
 }
 
@@ -374,16 +389,17 @@ sys_mknod(void)
   char path[MAXPATH];
   int major, minor;
 
-  begin_op(ROOTDEV);
   if((argstr(0, path, MAXPATH)) < 0 ||
      argint(1, &major) < 0 ||
-     argint(2, &minor) < 0 ||
-     (ip = create(path, T_DEVICE, major, minor)) == 0){
-    end_op(ROOTDEV);
+     argint(2, &minor) < 0)
+    return -1;
+  begin_pathop(pathdisk(path));
+  if((ip = create(path, T_DEVICE, major, minor)) == 0){
+    end_pathop();
     return -1;
   }
   iunlockput(ip);
-  end_op(ROOTDEV);
+  end_pathop();
   return 0;
 }
 
@@ -394,24 +410,49 @@ sys_chdir(void)
   struct inode *ip;
   struct proc *p = myproc();
   
-  begin_op(ROOTDEV);
-  if(argstr(0, path, MAXPATH) < 0 || (ip = namei(path)) == 0){
-    end_op(ROOTDEV);
+  if(argstr(0, path, MAXPATH) < 0)
+    return -1;
+  // the old cwd is put on its own disk
+  begin_pathop(pathdisk(path) == p->cwd->dev ? p->cwd->dev : ANYDISK);
+  if((ip = namei(path)) == 0){
+    end_pathop();
     return -1;
   }
   ilock(ip);
   if(ip->type != T_DIR){
     iunlockput(ip);
-    end_op(ROOTDEV);
+    end_pathop();
     return -1;
   }
   iunlock(ip);
   iput(p->cwd);
-  end_op(ROOTDEV);
+  end_pathop();
   p->cwd = ip;
   return 0;
 }
 
+// Mount the file system of disk n on the directory path.
+uint64
+sys_mount(void)
+{
+  char path[MAXPATH];
+  struct inode *ip;
+  int n, r;
+
+  if(argint(0, &n) < 0 || argstr(1, path, MAXPATH) < 0)
+    return -1;
+  begin_pathop(pathdisk(path));
+  if((ip = namei(path)) == 0){
+    end_pathop();
+    return -1;
+  }
+  ilock(ip);
+  r = mount(n, ip);
+  iunlockput(ip);
+  end_pathop();
+  return r;
+}
+
 uint64
 sys_exec(void)
 {
@@ -181,4 +181,16 @@ uint64
 sys_memory(void)
 {
     return bd_memory();
+}
+
+// return the spins on the buffer cache locks, printing them per
+// lock if the argument is nonzero
+uint64
+sys_ntas(void)
+{
+    int print;
+
+    if(argint(0, &print) < 0)
+        return -1;
+    return bstat(print);
 }
\ No newline at end of file
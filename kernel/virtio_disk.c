@@ -41,6 +41,7 @@ struct disk {
     struct {
         struct buf *b;
         char status;
+        struct virtio_blk_req req;  // the request's first descriptor
     } info[NUM];
 
     // initialized?
@@ -51,26 +52,28 @@ struct disk {
 
 
 
-void
+// Set up disk n, if it has not been. Returns -1 if there is no disk
+// attached as n.
+int
 virtio_disk_init(int n)
 {
     uint32 status = 0;
 
     __sync_synchronize();
     if(disk[n].init)
-        return;
-
-    printf("virtio disk init %d\n", n);
-
-    initlock(&disk[n].vdisk_lock, "virtio_disk");
+        return 0;
 
     if(*R(n, VIRTIO_MMIO_MAGIC_VALUE) != 0x74726976 ||
        *R(n, VIRTIO_MMIO_VERSION) != 1 ||
        *R(n, VIRTIO_MMIO_DEVICE_ID) != 2 ||
        *R(n, VIRTIO_MMIO_VENDOR_ID) != 0x554d4551){
-        panic("could not find virtio disk");
+        return -1;
     }
 
+    printf("virtio disk init %d\n", n);
+
+    initlock(&disk[n].vdisk_lock, "virtio_disk");
+
     status |= VIRTIO_CONFIG_S_ACKNOWLEDGE;
     *R(n, VIRTIO_MMIO_STATUS) = status;
 
@@ -122,6 +125,7 @@ virtio_disk_init(int n)
 
     disk[n].init = 1;
     // plic.c and trap.c arrange for interrupts from VIRTIO0_IRQ.
+    return 0;
 }
 
 // find a free descriptor, mark it non-free, return its index.
@@ -164,9 +168,9 @@ free_chain(int n, int i)
 }
 
 static int
-alloc3_desc(int n, int *idx)
+alloc_descs(int n, int *idx, int cnt)
 {
-    for(int i = 0; i < 3; i++){
+    for(int i = 0; i < cnt; i++){
         idx[i] = alloc_desc(n);
         if(idx[i] < 0){
             for(int j = 0; j < i; j++)
@@ -177,63 +181,74 @@ alloc3_desc(int n, int *idx)
     return 0;
 }
 
-void
-virtio_disk_rw(int n, struct buf *b, int write)
+// Queue a request for b without telling the device; the caller
+// holds vdisk_lock. If the ring is full, the requests queued so far
+// are handed to the device first so that they can finish and free
+// descriptors.
+static void
+submit(int n, struct buf *b, int write)
 {
-    uint64 sector = b->blockno * (BSIZE / 512);
-
-    acquire(&disk[n].vdisk_lock);
-
     // the spec says that legacy block operations use three
     // descriptors: one for type/reserved/sector, one for
-    // the data, one for a 1-byte status result.
+    // the data, one for a 1-byte status result. Direct I/O
+    // has a data descriptor for each user page instead.
+    int nseg = b->data ? 1 : (b->uoff + b->size + PGSIZE - 1) / PGSIZE;
 
-    // allocate the three descriptors.
-    int idx[3];
+    // allocate the descriptors.
+    int idx[2 + NUPAGE];
     while(1){
-        if(alloc3_desc(n, idx) == 0) {
+        if(alloc_descs(n, idx, 2 + nseg) == 0) {
             break;
         }
+        *R(n, VIRTIO_MMIO_QUEUE_NOTIFY) = 0;
         sleep(&disk[n].free[0], &disk[n].vdisk_lock);
     }
 
-    // format the three descriptors.
+    // format the descriptors.
     // qemu's virtio-blk.c reads them.
 
-    struct virtio_blk_outhdr {
-        uint32 type;
-        uint32 reserved;
-        uint64 sector;
-    } buf0;
+    struct virtio_blk_req *buf0 = &disk[n].info[idx[0]].req;
 
     if(write)
-        buf0.type = VIRTIO_BLK_T_OUT; // write the disk
+        buf0->type = VIRTIO_BLK_T_OUT; // write the disk
     else
-        buf0.type = VIRTIO_BLK_T_IN; // read the disk
-    buf0.reserved = 0;
-    buf0.sector = sector;
-
-    // buf0 is on a kernel stack, which is not direct mapped,
-    // thus the call to kvmpa().
-    disk[n].desc[idx[0]].addr = (uint64) kvmpa((uint64) &buf0);
-    disk[n].desc[idx[0]].len = sizeof(buf0);
+        buf0->type = VIRTIO_BLK_T_IN; // read the disk
+    buf0->reserved = 0;
+    buf0->sector = b->blockno * (b->size / 512);
+
+    // buf0 lives in disk[], not on the caller's stack, so that it
+    // outlasts the call.
+    disk[n].desc[idx[0]].addr = (uint64) buf0;
+    disk[n].desc[idx[0]].len = sizeof(*buf0);
     disk[n].desc[idx[0]].flags = VRING_DESC_F_NEXT;
     disk[n].desc[idx[0]].next = idx[1];
 
-    disk[n].desc[idx[1]].addr = (uint64) b->data;
-    disk[n].desc[idx[1]].len = BSIZE;
-    if(write)
-        disk[n].desc[idx[1]].flags = 0; // device reads b->data
-    else
-        disk[n].desc[idx[1]].flags = VRING_DESC_F_WRITE; // device writes b->data
-    disk[n].desc[idx[1]].flags |= VRING_DESC_F_NEXT;
-    disk[n].desc[idx[1]].next = idx[2];
+    uint len = b->size;
+    for(int i = 1; i <= nseg; i++){
+        struct VRingDesc *d = &disk[n].desc[idx[i]];
+        if(b->data){
+            d->addr = (uint64) b->data;
+            d->len = b->size;
+        } else {
+            uint skip = i == 1 ? b->uoff : 0;
+            d->addr = b->upa[i-1] + skip;
+            d->len = PGSIZE - skip < len ? PGSIZE - skip : len;
+        }
+        len -= d->len;
+        if(write)
+            d->flags = 0; // device reads b->data
+        else
+            d->flags = VRING_DESC_F_WRITE; // device writes b->data
+        d->flags |= VRING_DESC_F_NEXT;
+        d->next = idx[i+1];
+    }
 
+    int st = idx[nseg+1];
     disk[n].info[idx[0]].status = 0;
-    disk[n].desc[idx[2]].addr = (uint64) &disk[n].info[idx[0]].status;
-    disk[n].desc[idx[2]].len = 1;
-    disk[n].desc[idx[2]].flags = VRING_DESC_F_WRITE; // device writes the status
-    disk[n].desc[idx[2]].next = 0;
+    disk[n].desc[st].addr = (uint64) &disk[n].info[idx[0]].status;
+    disk[n].desc[st].len = 1;
+    disk[n].desc[st].flags = VRING_DESC_F_WRITE; // device writes the status
+    disk[n].desc[st].next = 0;
 
     // record struct buf for virtio_disk_intr().
     b->disk = 1;
@@ -246,20 +261,40 @@ virtio_disk_rw(int n, struct buf *b, int write)
     disk[n].avail[2 + (disk[n].avail[1] % NUM)] = idx[0];
     __sync_synchronize();
     disk[n].avail[1] = disk[n].avail[1] + 1;
+}
 
+// Start reading (write == 0) or writing the cnt locked bufs in bs
+// and tell the device once. Returns at once; wait for each buf
+// with virtio_disk_wait().
+void
+virtio_disk_start(int n, struct buf **bs, int cnt, int write)
+{
+    acquire(&disk[n].vdisk_lock);
+    for(int i = 0; i < cnt; i++)
+        submit(n, bs[i], write);
+    __sync_synchronize();
     *R(n, VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
+    release(&disk[n].vdisk_lock);
+}
 
-    // Wait for virtio_disk_intr() to say request has finished.
+// Wait for virtio_disk_intr() to say the request for b has finished.
+void
+virtio_disk_wait(int n, struct buf *b)
+{
+    acquire(&disk[n].vdisk_lock);
     while(b->disk == 1) {
         sleep(b, &disk[n].vdisk_lock);
     }
-
-    disk[n].info[idx[0]].b = 0;
-    free_chain(n, idx[0]);
-
     release(&disk[n].vdisk_lock);
 }
 
+void
+virtio_disk_rw(int n, struct buf *b, int write)
+{
+    virtio_disk_start(n, &b, 1, write);
+    virtio_disk_wait(n, b);
+}
+
 void
 virtio_disk_intr(int n)
 {
@@ -267,16 +302,20 @@ virtio_disk_intr(int n)
 
     while((disk[n].used_idx % NUM) != (disk[n].used->id % NUM)){
         int id = disk[n].used->elems[disk[n].used_idx].id;
+        struct buf *b = disk[n].info[id].b;
 
         if(disk[n].info[id].status != 0)
             panic("virtio_disk_intr status");
 
-        disk[n].info[id].b->disk = 0;   // disk is done with buf
-        wakeup(disk[n].info[id].b);
+        // freed here rather than by the waiter, which may not be
+        // waiting yet
+        disk[n].info[id].b = 0;
+        free_chain(n, id);
+        b->disk = 0;   // disk is done with buf
+        wakeup(b);
 
         disk[n].used_idx = (disk[n].used_idx + 1) % NUM;
     }
 
     release(&disk[n].vdisk_lock);
 }
-
@@ -20,15 +20,17 @@
 // Disk layout:
 // [ boot block | sb block | log | inode blocks | free bit map | data blocks ]
 
-int nbitmap = FSSIZE/(BSIZE*8) + 1;
-int ninodeblocks = NINODES / IPB + 1;
+uint bsize = BSIZE;
+int nfsblocks;  // the FSSIZE BSIZE blocks of the image, in bsize blocks
+int nbitmap;
+int ninodeblocks;
 int nlog = LOGSIZE;
 int nmeta;    // Number of meta blocks (boot, sb, nlog, inode, bitmap)
 int nblocks;  // Number of data blocks
 
 int fsfd;
 struct superblock sb;
-char zeroes[BSIZE];
+char zeroes[MAXBSIZE];
 uint freeinode = 1;
 uint freeblock;
 
@@ -71,30 +73,39 @@ main(int argc, char *argv[])
     int i, cc, fd;
     uint rootino, inum, off;
     struct dirent de;
-    char buf[BSIZE];
+    char buf[MAXBSIZE];
     struct dinode din;
 
 
     static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
 
-    if(argc < 2){
-        fprintf(stderr, "Usage: mkfs fs.img files...\n");
+    if(argc > 2 && strcmp(argv[1], "-b") == 0){
+        bsize = atoi(argv[2]);
+        argc -= 2;
+        argv += 2;
+    }
+    if(argc < 2 || bsize < MINBSIZE || bsize > MAXBSIZE || (bsize & (bsize - 1)) != 0){
+        fprintf(stderr, "Usage: mkfs [-b bsize] fs.img files...\n");
         exit(1);
     }
 
-    assert((BSIZE % sizeof(struct dinode)) == 0);
-    assert((BSIZE % sizeof(struct dirent)) == 0);
+    assert((MINBSIZE % sizeof(struct dinode)) == 0);
+    assert((MINBSIZE % sizeof(struct dirent)) == 0);
 
     fsfd = open(argv[1], O_RDWR|O_CREAT|O_TRUNC, 0666);
     if(fsfd < 0)
         die(argv[1]);
 
     // 1 fs block = 1 disk sector
+    sb.bsize = xint(bsize);
+    nfsblocks = FSSIZE * (BSIZE / bsize);
+    nbitmap = nfsblocks/(bsize*8) + 1;
+    ninodeblocks = NINODES / IPB(sb) + 1;
     nmeta = 2 + nlog + ninodeblocks + nbitmap;
-    nblocks = FSSIZE - nmeta;
+    nblocks = nfsblocks - nmeta;
 
     sb.magic = FSMAGIC;
-    sb.size = xint(FSSIZE);
+    sb.size = xint(nfsblocks);
     sb.nblocks = xint(nblocks);
     sb.ninodes = xint(NINODES);
     sb.nlog = xint(nlog);
@@ -102,12 +113,12 @@ main(int argc, char *argv[])
     sb.inodestart = xint(2+nlog);
     sb.bmapstart = xint(2+nlog+ninodeblocks);
 
-    printf("nmeta %d (boot, super, log blocks %u inode blocks %u, bitmap blocks %u) blocks %d total %d\n",
-           nmeta, nlog, ninodeblocks, nbitmap, nblocks, FSSIZE);
+    printf("nmeta %d (boot, super, log blocks %u inode blocks %u, bitmap blocks %u) blocks %d total %d of %u bytes\n",
+           nmeta, nlog, ninodeblocks, nbitmap, nblocks, nfsblocks, bsize);
 
     freeblock = nmeta;     // the first free block that we can allocate
 
-    for(i = 0; i < FSSIZE; i++)
+    for(i = 0; i < nfsblocks; i++)
         wsect(i, zeroes);
 
     memset(buf, 0, sizeof(buf));
@@ -163,7 +174,7 @@ main(int argc, char *argv[])
     // fix size of root inode dir
     rinode(rootino, &din);
     off = xint(din.size);
-    off = ((off/BSIZE) + 1) * BSIZE;
+    off = ((off/bsize) + 1) * bsize;
     din.size = xint(off);
     winode(rootino, &din);
 
@@ -175,22 +186,22 @@ main(int argc, char *argv[])
 void
 wsect(uint sec, void *buf)
 {
-    if(lseek(fsfd, sec * BSIZE, 0) != sec * BSIZE)
+    if(lseek(fsfd, (off_t)sec * bsize, 0) != (off_t)sec * bsize)
         die("lseek");
-    if(write(fsfd, buf, BSIZE) != BSIZE)
+    if(write(fsfd, buf, bsize) != bsize)
         die("write");
 }
 
 void
 winode(uint inum, struct dinode *ip)
 {
-    char buf[BSIZE];
+    char buf[MAXBSIZE];
     uint bn;
     struct dinode *dip;
 
     bn = IBLOCK(inum, sb);
     rsect(bn, buf);
-    dip = ((struct dinode*)buf) + (inum % IPB);
+    dip = ((struct dinode*)buf) + (inum % IPB(sb));
     *dip = *ip;
     wsect(bn, buf);
 }
@@ -198,22 +209,22 @@ winode(uint inum, struct dinode *ip)
 void
 rinode(uint inum, struct dinode *ip)
 {
-    char buf[BSIZE];
+    char buf[MAXBSIZE];
     uint bn;
     struct dinode *dip;
 
     bn = IBLOCK(inum, sb);
     rsect(bn, buf);
-    dip = ((struct dinode*)buf) + (inum % IPB);
+    dip = ((struct dinode*)buf) + (inum % IPB(sb));
     *ip = *dip;
 }
 
 void
 rsect(uint sec, void *buf)
 {
-    if(lseek(fsfd, sec * BSIZE, 0) != sec * BSIZE)
+    if(lseek(fsfd, (off_t)sec * bsize, 0) != (off_t)sec * bsize)
         die("lseek");
-    if(read(fsfd, buf, BSIZE) != BSIZE)
+    if(read(fsfd, buf, bsize) != bsize)
         die("read");
 }
 
@@ -234,56 +245,94 @@ ialloc(ushort type)
 void
 balloc(int used)
 {
-    uchar buf[BSIZE];
-    int i;
+    uchar buf[MAXBSIZE];
+    int i, b;
 
     printf("balloc: first %d blocks have been allocated\n", used);
-    assert(used < BSIZE*8);
-    bzero(buf, BSIZE);
-    for(i = 0; i < used; i++){
-        buf[i/8] = buf[i/8] | (0x1 << (i%8));
+    assert(used < nbitmap*bsize*8);
+    for(b = 0; b < nbitmap; b++){
+        bzero(buf, bsize);
+        for(i = 0; i < bsize*8 && b*bsize*8 + i < used; i++){
+            buf[i/8] = buf[i/8] | (0x1 << (i%8));
+        }
+        printf("balloc: write bitmap block at sector %d\n", sb.bmapstart + b);
+        wsect(sb.bmapstart + b, buf);
     }
-    printf("balloc: write bitmap block at sector %d\n", sb.bmapstart);
-    wsect(sb.bmapstart, buf);
 }
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
+// entry i of indirect block *addr, both allocated if need be
+uint
+ientry(uint *addr, uint i)
+{
+    uint a[MAXBSIZE / sizeof(uint)];
+
+    if(xint(*addr) == 0)
+        *addr = xint(freeblock++);
+    rsect(xint(*addr), (char*)a);
+    if(a[i] == 0){
+        a[i] = xint(freeblock++);
+        wsect(xint(*addr), (char*)a);
+    }
+    return xint(a[i]);
+}
+
+// The block of file block fbn, as the kernel's bmap() lays it out.
+uint
+bmap(struct dinode *din, uint fbn)
+{
+    struct extent *e;
+    uint i, x;
+
+    for(i = 0; i < xint(din->nextent); i++){
+        e = &din->ext[i];
+        if(fbn < xint(e->len))
+            return xint(e->start) + fbn;
+        fbn -= xint(e->len);
+    }
+    assert(fbn == 0 || din->indirect != 0 || din->dindirect != 0);
+    if(din->indirect == 0 && din->dindirect == 0){
+        e = i > 0 ? &din->ext[i-1] : 0;
+        if(e && xint(e->start) + xint(e->len) == freeblock){
+            e->len = xint(xint(e->len) + 1);
+            return freeblock++;
+        }
+        if(i < NEXTENT){
+            e = &din->ext[i];
+            din->nextent = xint(i + 1);
+            e->start = xint(freeblock++);
+            e->len = xint(1);
+            return xint(e->start);
+        }
+    }
+    if(fbn < NINDIRECT(sb))
+        return ientry(&din->indirect, fbn);
+    fbn -= NINDIRECT(sb);
+    x = ientry(&din->dindirect, fbn / NINDIRECT(sb));
+    x = xint(x);
+    return ientry(&x, fbn % NINDIRECT(sb));
+}
+
 void
 iappend(uint inum, void *xp, int n)
 {
     char *p = (char*)xp;
     uint fbn, off, n1;
     struct dinode din;
-    char buf[BSIZE];
-    uint indirect[NINDIRECT];
+    char buf[MAXBSIZE];
     uint x;
 
     rinode(inum, &din);
     off = xint(din.size);
     // printf("append inum %d at off %d sz %d\n", inum, off, n);
     while(n > 0){
-        fbn = off / BSIZE;
-        assert(fbn < MAXFILE);
-        if(fbn < NDIRECT){
-            if(xint(din.addrs[fbn]) == 0){
-                din.addrs[fbn] = xint(freeblock++);
-            }
-            x = xint(din.addrs[fbn]);
-        } else {
-            if(xint(din.addrs[NDIRECT]) == 0){
-                din.addrs[NDIRECT] = xint(freeblock++);
-            }
-            rsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-            if(indirect[fbn - NDIRECT] == 0){
-                indirect[fbn - NDIRECT] = xint(freeblock++);
-                wsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-            }
-            x = xint(indirect[fbn-NDIRECT]);
-        }
-        n1 = min(n, (fbn + 1) * BSIZE - off);
+        fbn = off / bsize;
+        assert(fbn < MAXFILE(sb));
+        x = bmap(&din, fbn);
+        n1 = min(n, (fbn + 1) * bsize - off);
         rsect(x, buf);
-        bcopy(p, buf + off - (fbn * BSIZE), n1);
+        bcopy(p, buf + off - (fbn * bsize), n1);
         wsect(x, buf);
         n -= n1;
         off += n1;
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kernel/types.h"
+#include "user/rgb.h"
+
+// rgbenc [-k keyint] [-r fps] in.rgb out.rgb
+//
+// Compress a plain .rgb stream (320x200 RGB565 frames, as made by
+// ffmpeg -pix_fmt rgb565le) into the tile-RLE format of user/rgb.h.
+// Every keyint-th frame is a key frame; the others only carry the
+// tiles that changed, so mostly static video shrinks many times.
+
+#define FRAME_PIXELS (RGB_WIDTH * RGB_HEIGHT)
+
+static uint16 cur[FRAME_PIXELS], prev[FRAME_PIXELS];
+static uchar out[RGB_MAXFRAME];
+
+static void
+put16(uchar *p, uint x)
+{
+    p[0] = x;
+    p[1] = x >> 8;
+}
+
+static void
+put32(uchar *p, uint x)
+{
+    put16(p, x);
+    put16(p + 2, x >> 16);
+}
+
+// copy tile t of frame f out row by row
+static void
+gettile(const uint16 *f, int t, uint16 *px)
+{
+    int x0 = t % RGB_TILES_X * RGB_TILE_W, y0 = t / RGB_TILES_X * RGB_TILE_H;
+    int y;
+
+    for(y = 0; y < RGB_TILE_H; y++)
+        memcpy(px + y * RGB_TILE_W, f + (y0 + y) * RGB_WIDTH + x0, RGB_TILE_W * 2);
+}
+
+// Runs of three or more equal pixels are worth a repeat; shorter
+// ones stay in the literal around them.
+static uchar*
+rle(const uint16 *px, int n, uchar *p)
+{
+    int i = 0, j, run;
+
+    while(i < n){
+        for(run = 1; i + run < n && run < 129 && px[i + run] == px[i]; run++)
+            ;
+        if(run >= 3){
+            *p++ = run + 126;
+            put16(p, px[i]);
+            p += 2;
+            i += run;
+            continue;
+        }
+        for(j = i; j < n && j - i < 128; j++)
+            if(j + 2 < n && px[j] == px[j + 1] && px[j] == px[j + 2])
+                break;
+        *p++ = j - i - 1;
+        for(; i < j; i++, p += 2)
+            put16(p, px[i]);
+    }
+    return p;
+}
+
+static void
+usage(void)
+{
+    fprintf(stderr, "Usage: rgbenc [-k keyint] [-r fps] in.rgb out.rgb\n");
+    exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct RGB_Header h;
+    uint16 a[RGB_TILE_PIXELS], b[RGB_TILE_PIXELS];
+    uchar *p, hdr[sizeof(struct rgbframe)];
+    long insize = 0, outsize = 0, tiles = 0;
+    int keyint = 50, nframe, nkey = 0, ntiles, key, t;
+    double fps = 10;
+    FILE *in, *fout;
+
+    for(; argc > 1 && argv[1][0] == '-'; argc--, argv++){
+        if(argc < 3)
+            usage();
+        if(strcmp(argv[1], "-k") == 0)
+            keyint = atoi(argv[2]);
+        else if(strcmp(argv[1], "-r") == 0)
+            fps = atof(argv[2]);
+        else
+            usage();
+        argc--;
+        argv++;
+    }
+    if(argc != 3 || keyint < 1 || fps <= 0)
+        usage();
+    if((in = fopen(argv[1], "rb")) == 0){
+        perror(argv[1]);
+        exit(1);
+    }
+    if((fout = fopen(argv[2], "wb")) == 0){
+        perror(argv[2]);
+        exit(1);
+    }
+
+    memset(&h, 0, sizeof(h));
+    put16((uchar*)&h.type, RGB_MAGIC);
+    h.compression = 1;
+    h.bytesPerPixel = 2;
+    put16((uchar*)&h.dimension, 3);
+    put16((uchar*)&h.width, RGB_WIDTH);
+    put16((uchar*)&h.height, RGB_HEIGHT);
+    put16((uchar*)&h.channels, 3);
+    put32((uchar*)&h.maxPixelValue, 0xffff);
+    put32((uchar*)&h.frametime, (uint)(1000000 / fps + 0.5));
+    strncpy(h.name, argv[1], sizeof(h.name) - 1);
+    fwrite(&h, sizeof(h), 1, fout);
+    outsize += sizeof(h);
+
+    // the input is little-endian like the output, so pixels are
+    // only compared and copied, never interpreted
+    for(nframe = 0; fread(cur, sizeof(cur), 1, in) == 1; nframe++){
+        key = nframe % keyint == 0;
+        p = out;
+        ntiles = 0;
+        for(t = 0; t < RGB_NTILES; t++){
+            gettile(cur, t, a);
+            if(!key){
+                gettile(prev, t, b);
+                if(memcmp(a, b, sizeof(a)) == 0)
+                    continue;
+            }
+            put16(p, t);
+            p = rle(a, RGB_TILE_PIXELS, p + 2);
+            ntiles++;
+        }
+        put32(hdr, p - out);
+        put16(hdr + 4, ntiles);
+        put16(hdr + 6, key ? RGB_KEY : 0);
+        fwrite(hdr, sizeof(hdr), 1, fout);
+        fwrite(out, p - out, 1, fout);
+        memcpy(prev, cur, sizeof(cur));
+        insize += sizeof(cur);
+        outsize += sizeof(hdr) + (p - out);
+        tiles += ntiles;
+        nkey += key;
+    }
+    if(ferror(in) || fclose(fout) != 0){
+        perror("rgbenc");
+        exit(1);
+    }
+    fclose(in);
+
+    printf("%d frames (%d key), %ld of %ld tiles coded, %ld -> %ld bytes",
+           nframe, nkey, tiles, (long)nframe * RGB_NTILES, insize, outsize);
+    if(outsize > 0)
+        printf(" (%.1fx)", (double)insize / outsize);
+    printf("\n");
+    return 0;
+}
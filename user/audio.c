@@ -0,0 +1,100 @@
+#include "kernel/types.h"
+#include "kernel/riscv.h"
+#include "kernel/sound.h"
+#include "user/user.h"
+#include "user/audio.h"
+
+static char *mem;       // as returned by malloc
+static char *pool;      // page-aligned slots
+static int nslot;
+static int queued;      // slots handed to the card
+static int next;        // slot to fill after cur
+static int cur = -1;    // slot being filled, or -1
+static int fill;        // bytes in cur (audio_write)
+
+// Set the sample rate and pin the slots. Returns -1 if the card
+// is already in use by another zero-copy player.
+int
+audio_open(int rate)
+{
+    setSampleRate(rate);
+    mem = malloc(AUDIO_SLOTS * AUDIO_SLOT_SIZE + PGSIZE);
+    if(mem == 0)
+        return -1;
+    pool = (char*)PGROUNDUP((uint64)mem);
+    if((nslot = audiopin(pool, AUDIO_SLOTS * AUDIO_SLOT_SIZE)) <= 0){
+        free(mem);
+        return -1;
+    }
+    queued = next = fill = 0;
+    cur = -1;
+    return 0;
+}
+
+// The slot to fill next, waiting for the card to finish with one
+// if all are queued. The slots are played and freed in turn.
+short *
+audio_slot(void)
+{
+    if(cur < 0){
+        if(queued == nslot){
+            audiowait();
+            queued--;
+        }
+        cur = next;
+        next = (next + 1) % nslot;
+        fill = 0;
+    }
+    return (short*)(pool + cur * AUDIO_SLOT_SIZE);
+}
+
+// Queue the current slot holding nbytes of PCM; a short slot is
+// padded with silence.
+void
+audio_queue(int nbytes)
+{
+    char *p = (char*)audio_slot();
+
+    if(nbytes < AUDIO_SLOT_SIZE)
+        memset(p + nbytes, 0, AUDIO_SLOT_SIZE - nbytes);
+    audioqueue(cur);
+    queued++;
+    cur = -1;
+}
+
+// For producers with their own buffers: append PCM to the slots.
+void
+audio_write(const void *pcm, int nbytes)
+{
+    const char *p = pcm;
+    int n;
+
+    while(nbytes > 0){
+        char *dst = (char*)audio_slot();
+        n = AUDIO_SLOT_SIZE - fill;
+        if(n > nbytes)
+            n = nbytes;
+        memmove(dst + fill, p, n);
+        fill += n;
+        p += n;
+        nbytes -= n;
+        if(fill == AUDIO_SLOT_SIZE)
+            audio_queue(fill);
+    }
+}
+
+// Play out what is left, then unpin.
+void
+audio_close(void)
+{
+    if(cur >= 0 && fill > 0)
+        audio_queue(fill);
+    while(queued > 0){
+        if(audiowait() < 0)
+            break;
+        queued--;
+    }
+    audiopin(0, 0);
+    free(mem);
+    mem = pool = 0;
+}
@@ -0,0 +1,16 @@
+#ifndef _AUDIO_H_
+#define _AUDIO_H_
+
+// Zero-copy PCM output. The players fill slots of pinned memory
+// that the AC97 DMA engine reads directly (see audiopin()), rather
+// than handing every block to the kernel with kwrite().
+//
+// Samples are 16-bit stereo; a slot holds AUDIO_SLOT_SIZE bytes.
+
+int audio_open(int rate);
+short *audio_slot(void);
+void audio_queue(int nbytes);
+void audio_write(const void *pcm, int nbytes);
+void audio_close(void);
+
+#endif // _AUDIO_H_
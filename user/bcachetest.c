@@ -0,0 +1,70 @@
+// Contention benchmark for the buffer cache, after stressfs.
+// NCHILD processes each read small pieces of their own file over
+// and over, so that nearly every read is a cache hit and the time
+// goes to bget() and brelse(). ntas() tells how often the bcache
+// locks were found held meanwhile.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "kernel/fs.h"
+#include "kernel/fcntl.h"
+
+#define NCHILD 4
+#define NREAD 4000
+#define FILEBLOCKS 2
+#define PIECE 512
+
+char data[BSIZE];
+
+int
+main(int argc, char *argv[])
+{
+  int fd, i, j, t0, spins;
+  char path[] = "bcachetest0";
+
+  printf("bcachetest starting\n");
+  memset(data, 'a', sizeof(data));
+
+  for(i = 0; i < NCHILD; i++){
+    path[10] = '0' + i;
+    fd = open(path, O_CREATE | O_RDWR);
+    for(j = 0; j < FILEBLOCKS; j++)
+      if(write(fd, data, sizeof(data)) != sizeof(data)){
+        printf("bcachetest: write %s failed\n", path);
+        exit(1);
+      }
+    close(fd);
+  }
+
+  spins = ntas(0);
+  t0 = uptime();
+  for(i = 0; i < NCHILD; i++){
+    if(fork() == 0){
+      path[10] = '0' + i;
+      fd = open(path, O_RDONLY);
+      // every piece is cached after the first round
+      for(j = 0; j < NREAD; j++){
+        lseek(fd, (j % FILEBLOCKS) * BSIZE + (j / FILEBLOCKS % 8) * PIECE, SEEK_SET);
+        if(read(fd, data, PIECE) != PIECE){
+          printf("bcachetest: read %s failed\n", path);
+          exit(1);
+        }
+      }
+      close(fd);
+      exit(0);
+    }
+  }
+  for(i = 0; i < NCHILD; i++)
+    wait(0);
+
+  printf("bcachetest: %d reads by %d processes in %d ticks\n",
+         NCHILD * NREAD, NCHILD, uptime() - t0);
+  printf("bcachetest: %d spins on bcache locks\n", ntas(1) - spins);
+
+  for(i = 0; i < NCHILD; i++){
+    path[10] = '0' + i;
+    unlink(path);
+  }
+  exit(0);
+}
@@ -0,0 +1,122 @@
+#ifndef	_COMMON_H_
+#define	_COMMON_H_
+
+// Definitions shared by the MPEG-1 Layer III decoder (mp3dec.c,
+// huffman.c) and its users. Names follow the ISO dist10 reference
+// decoder so that the code can be read side by side with the
+// standard.
+
+#define PI              3.14159265358979
+#define SBLIMIT         32      // subbands
+#define SSLIMIT         18      // samples per subband per granule
+#define HAN_SIZE        512     // synthesis window length
+#define SCALE           32768
+
+#define SYNC_WORD       0xfff
+#define SYNC_WORD_LNGTH 12
+#define MPEG_AUDIO_ID   1
+
+#define MPG_MD_STEREO        0
+#define MPG_MD_JOINT_STEREO  1
+#define MPG_MD_DUAL_CHANNEL  2
+#define MPG_MD_MONO          3
+
+// bytes of main data that can sit in the bit reservoir
+#define BUFFER_SIZE     4096
+
+typedef struct {
+    int version;
+    int lay;
+    int error_protection;
+    int bitrate_index;
+    int sampling_frequency;
+    int padding;
+    int extension;
+    int mode;
+    int mode_ext;
+    int copyright;
+    int original;
+    int emphasis;
+} layer;
+
+struct frame_params {
+    layer *header;      // raw header information
+    int actual_mode;    // when writing IS, may forget if 0 chs
+    int stereo;         // 1 for mono, 2 for stereo
+    int jsbound;        // first band of joint stereo coding
+    int sblimit;        // total number of sub bands
+};
+
+// Input bitstream. Bytes come from fd through a small buffer
+// so that the stream can be searched for the next sync word.
+typedef struct bit_stream_struc {
+    int fd;
+    uchar buf[4096];
+    int buf_len;        // valid bytes in buf
+    int buf_byte_idx;   // next byte to consume
+    int buf_bit_idx;    // bits left in buf[buf_byte_idx]
+    unsigned long totbit;
+    int eob;            // end of file reached
+} Bit_stream_struc;
+
+struct gr_info_s {
+    unsigned part2_3_length;
+    unsigned big_values;
+    unsigned global_gain;
+    unsigned scalefac_compress;
+    unsigned window_switching_flag;
+    unsigned block_type;
+    unsigned mixed_block_flag;
+    unsigned table_select[3];
+    unsigned subblock_gain[3];
+    unsigned region0_count;
+    unsigned region1_count;
+    unsigned preflag;
+    unsigned scalefac_scale;
+    unsigned count1table_select;
+};
+
+struct III_side_info_t {
+    unsigned main_data_begin;
+    unsigned private_bits;
+    struct {
+        unsigned scfsi[4];
+        struct gr_info_s gr[2];
+    } ch[2];
+};
+
+typedef struct {
+    int l[23];          // [cb]
+    int s[3][13];       // [window][cb]
+} III_scalefac_t[2];    // [ch]
+
+// Huffman code table, see huffman.c
+struct huffcodetab {
+    int xlen;           // max. x-index
+    int ylen;           // max. y-index
+    int linbits;        // number of linbits
+    const unsigned short *hcod;
+    const unsigned char *hlen;
+    short (*tree)[2];   // decoding tree, built by initialize_huffman()
+};
+
+#define HTN 34
+extern struct huffcodetab ht[HTN];
+
+// bitstream.c-style helpers, in mp3dec.c
+void open_bit_stream_r(Bit_stream_struc *bs, int fd);
+unsigned int getbits(Bit_stream_struc *bs, int n);
+unsigned int get1bit(Bit_stream_struc *bs);
+unsigned long sstell(Bit_stream_struc *bs);
+int end_bs(Bit_stream_struc *bs);
+int seek_sync(Bit_stream_struc *bs, unsigned long sync, int N);
+
+// main data (bit reservoir) reader
+unsigned int hgetbits(int n);
+unsigned int hget1bit(void);
+unsigned long hsstell(void);
+void rewindNbits(int n);
+
+int huffman_decoder(struct huffcodetab *h, int *x, int *y, int *v, int *w);
+
+#endif	//_COMMON_H_
@@ -22,9 +22,30 @@ void create_syn_filter(double filter[64][SBLIMIT]);
 void read_syn_window(double window[HAN_SIZE]);
 int SubBandSynthesis (double *bandPtr, int channel, short *samples);
 
+// Fixed-point versions of the hybrid filterbank and the synthesis,
+// used unless mp3_use_double is set. fixed_t signals carry FRAC_BITS
+// fraction bits, table coefficients COEF_BITS.
+typedef int fixed_t;
+#define FRAC_BITS 24
+#define COEF_BITS 24
+
+void inv_mdct_fixed(fixed_t in[18], fixed_t out[36], int block_type);
+void III_hybrid_fixed(fixed_t fsIn[SSLIMIT], fixed_t tsOut[SSLIMIT], int sb, int ch, struct gr_info_s *gr_info, struct frame_params *fr_ps);
+void dct32_fixed(fixed_t in[32], fixed_t out[32]);
+int SubBandSynthesis_fixed(fixed_t *bandPtr, int channel, short *samples);
+
 void out_fifo(short pcm_sample[2][SSLIMIT][SBLIMIT], int num, struct frame_params *fr_ps, unsigned long *psampFrames);
 void buffer_CRC(Bit_stream_struc *bs, unsigned int *old_crc);
 int main_data_slots(struct frame_params fr_ps);
 
+// Decode the next frame of bs. The PCM, always 16-bit stereo, is
+// handed to pcm_sink one granule at a time. Returns the number of
+// sample frames produced, 0 at the end of the stream.
+int mp3_decode_frame(Bit_stream_struc *bs, struct frame_params *fr_ps);
+extern void (*pcm_sink)(const short *pcm, int nbytes);
+void mp3_reset(void);
+extern int mp3_use_double;
+
 extern double gb_window[HAN_SIZE];
+extern int s_freq[4];
 #endif	//_DECODE_H_
@@ -0,0 +1,119 @@
+// File system benchmark, for comparing block sizes: build fs.img
+// with make FSBSIZE=4096 (or 16384, 65536) and run fsbench on each.
+// The small-file part creates, reads back and removes NSMALL files
+// of SMALLSIZE bytes, the way scripts and notes use the disk; the
+// streaming part writes and reads back one file of MB megabytes in
+// CHUNK pieces, the way the players read their media.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+#include "kernel/fcntl.h"
+
+#define TICKS_PER_SEC 10      // timer interval in kernel/start.c
+#define NSMALL 64
+#define SMALLSIZE 1500
+#define CHUNK 65536
+
+char buf[CHUNK];
+
+static char*
+smallname(int i)
+{
+  static char name[] = "fsbench.00";
+
+  name[8] = '0' + i / 10 % 10;
+  name[9] = '0' + i % 10;
+  return name;
+}
+
+static void
+report(char *what, int n, char *unit, int ticks)
+{
+  if(ticks < 1)
+    ticks = 1;
+  printf("fsbench: %s %d %s in %d ms, %d %s/s\n", what, n, unit,
+         ticks * 1000 / TICKS_PER_SEC, n * TICKS_PER_SEC / ticks, unit);
+}
+
+static void
+small(void)
+{
+  int i, fd, t0;
+
+  t0 = uptime();
+  for(i = 0; i < NSMALL; i++){
+    if((fd = open(smallname(i), O_CREATE | O_WRONLY)) < 0 ||
+       write(fd, buf, SMALLSIZE) != SMALLSIZE){
+      printf("fsbench: cannot write %s\n", smallname(i));
+      exit(1);
+    }
+    close(fd);
+  }
+  report("create", NSMALL, "files", uptime() - t0);
+
+  t0 = uptime();
+  for(i = 0; i < NSMALL; i++){
+    if((fd = open(smallname(i), O_RDONLY)) < 0 || read(fd, buf, CHUNK) != SMALLSIZE){
+      printf("fsbench: cannot read %s\n", smallname(i));
+      exit(1);
+    }
+    close(fd);
+  }
+  report("read", NSMALL, "files", uptime() - t0);
+
+  t0 = uptime();
+  for(i = 0; i < NSMALL; i++)
+    unlink(smallname(i));
+  report("unlink", NSMALL, "files", uptime() - t0);
+}
+
+static void
+stream(int mb)
+{
+  int i, n = mb * (1024 * 1024 / CHUNK), fd, t0;
+
+  t0 = uptime();
+  if((fd = open("fsbench.big", O_CREATE | O_WRONLY)) < 0){
+    printf("fsbench: cannot create fsbench.big\n");
+    exit(1);
+  }
+  for(i = 0; i < n; i++){
+    if(write(fd, buf, CHUNK) != CHUNK){
+      printf("fsbench: write fsbench.big failed, disk full?\n");
+      unlink("fsbench.big");
+      exit(1);
+    }
+  }
+  close(fd);
+  report("write", n * (CHUNK / 1024), "KB", uptime() - t0);
+
+  t0 = uptime();
+  fd = open("fsbench.big", O_RDONLY);
+  for(i = 0; i < n; i++){
+    if(read(fd, buf, CHUNK) != CHUNK){
+      printf("fsbench: read fsbench.big failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+  report("read", n * (CHUNK / 1024), "KB", uptime() - t0);
+  unlink("fsbench.big");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mb = 16;
+
+  if(argc > 2 && strcmp(argv[1], "-m") == 0)
+    mb = atoi(argv[2]);
+  else if(argc > 1){
+    printf("usage: fsbench [-m MB]\n");
+    exit(1);
+  }
+  memset(buf, 'a', sizeof(buf));
+  small();
+  stream(mb);
+  exit(0);
+}
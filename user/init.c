@@ -22,6 +22,11 @@ main(void)
   }
   dup(0);  // stdout
   dup(0);  // stderr
+
+  // the media files are on their own disk
+  mkdir("/media");
+  if(mount(1, "/media") < 0)
+    printf("init: no media disk to mount on /media\n");
   
   for(;;){
     printf("init: starting mysh\n");
@@ -0,0 +1,19 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// mount disk dir: put the file system of disk (1 is media.img)
+// on the directory dir.
+int
+main(int argc, char *argv[])
+{
+  if(argc != 3){
+    fprintf(2, "Usage: mount disk dir\n");
+    exit(1);
+  }
+  if(mount(atoi(argv[1]), argv[2]) < 0){
+    fprintf(2, "mount: cannot mount disk %s on %s\n", argv[1], argv[2]);
+    exit(1);
+  }
+  exit(0);
+}
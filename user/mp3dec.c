@@ -0,0 +1,1305 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/decode.h"
+
+// MPEG-1 Layer III decoder.
+//
+// The structure follows the ISO dist10 reference decoder: every
+// stage of the pipeline is a function declared in decode.h and the
+// names match the standard. mp3_decode_frame() drives the stages for
+// one frame and hands the PCM to pcm_sink.
+//
+// There is no libm in xv6, so the few transcendental values needed
+// are computed once by the helpers below when the first frame is
+// decoded.
+
+int s_freq[4] = {44100, 48000, 32000, 0};
+static int bitrate[15] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320};
+
+static struct {
+    int l[23];
+    int s[14];
+} sfBandIndex[3] = {
+    {{0, 4, 8, 12, 16, 20, 24, 30, 36, 44, 52, 62, 74, 90, 110, 134, 162, 196, 238, 288, 342, 418, 576},
+     {0, 4, 8, 12, 16, 22, 30, 40, 52, 66, 84, 106, 136, 192}},
+    {{0, 4, 8, 12, 16, 20, 24, 30, 36, 42, 50, 60, 72, 88, 106, 128, 156, 190, 230, 276, 330, 384, 576},
+     {0, 4, 8, 12, 16, 22, 28, 38, 50, 64, 80, 100, 126, 192}},
+    {{0, 4, 8, 12, 16, 20, 24, 30, 36, 44, 54, 66, 82, 102, 126, 156, 194, 240, 296, 364, 448, 550, 576},
+     {0, 4, 8, 12, 16, 22, 30, 42, 58, 78, 104, 138, 180, 192}},
+};
+
+static int slen[2][16] = {
+    {0, 0, 0, 0, 3, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4},
+    {0, 1, 2, 3, 0, 1, 2, 3, 1, 2, 3, 1, 2, 3, 2, 3},
+};
+
+static int pretab[22] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 3, 3, 3, 2, 0};
+
+static double Ci[8] = {-0.6, -0.535, -0.33, -0.185, -0.095, -0.041, -0.0142, -0.0037};
+
+// First half of the synthesis window D[] of table 3-B.3, in units
+// of 2^-16 and without the sign flips of every other 64-sample
+// block; read_syn_window() rebuilds the full table.
+static int intwinbase[257] = {
+     0,    -1,    -1,    -1,    -1,    -1,    -1,    -2,    -2,    -2,
+    -2,    -3,    -3,    -4,    -4,    -5,    -5,    -6,    -7,    -7,
+    -8,    -9,   -10,   -11,   -13,   -14,   -16,   -17,   -19,   -21,
+   -24,   -26,   -29,   -31,   -35,   -38,   -41,   -45,   -49,   -53,
+   -58,   -63,   -68,   -73,   -79,   -85,   -91,   -97,  -104,  -111,
+  -117,  -125,  -132,  -139,  -147,  -154,  -161,  -169,  -176,  -183,
+  -190,  -196,  -202,  -208,  -213,  -218,  -222,  -225,  -227,  -228,
+  -228,  -227,  -224,  -221,  -215,  -208,  -200,  -189,  -177,  -163,
+  -146,  -127,  -106,   -83,   -57,   -29,     2,    36,    72,   111,
+   153,   197,   244,   294,   347,   401,   459,   519,   581,   645,
+   711,   779,   848,   919,   991,  1064,  1137,  1210,  1283,  1356,
+  1428,  1498,  1567,  1634,  1698,  1759,  1817,  1870,  1919,  1962,
+  2001,  2032,  2057,  2075,  2085,  2087,  2080,  2063,  2037,  2000,
+  1952,  1893,  1822,  1739,  1644,  1535,  1414,  1280,  1131,   970,
+   794,   605,   402,   185,   -45,  -288,  -545,  -814, -1095, -1388,
+ -1692, -2006, -2330, -2663, -3004, -3351, -3705, -4063, -4425, -4788,
+ -5153, -5517, -5879, -6237, -6589, -6935, -7271, -7597, -7910, -8209,
+ -8491, -8755, -8998, -9219, -9416, -9585, -9727, -9838, -9916, -9959,
+ -9966, -9935, -9863, -9750, -9592, -9389, -9139, -8840, -8492, -8092,
+ -7640, -7134, -6574, -5959, -5288, -4561, -3776, -2935, -2037, -1082,
+   -70,   998,  2122,  3300,  4533,  5818,  7154,  8540,  9975, 11455,
+ 12980, 14548, 16155, 17799, 19478, 21189, 22929, 24694, 26482, 28289,
+ 30112, 31947, 33791, 35640, 37489, 39336, 41176, 43006, 44821, 46617,
+ 48390, 50137, 51853, 53534, 55178, 56778, 58333, 59838, 61289, 62684,
+ 64019, 65290, 66494, 67629, 68692, 69679, 70590, 71420, 72169, 72835,
+ 73415, 73908, 74313, 74630, 74856, 74992, 75038,
+};
+
+void (*pcm_sink)(const short *pcm, int nbytes);
+double gb_window[HAN_SIZE];
+
+// ---------------------------------------------------------------
+// math helpers, only used to fill tables
+
+static double
+msin(double x)
+{
+    double term, sum;
+    int i;
+
+    x -= (long)(x / (2 * PI)) * (2 * PI);
+    if(x > PI)
+        x -= 2 * PI;
+    else if(x < -PI)
+        x += 2 * PI;
+    term = sum = x;
+    for(i = 1; i < 15; i++){
+        term *= -x * x / ((2 * i) * (2 * i + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+static double
+mcos(double x)
+{
+    return msin(x + PI / 2);
+}
+
+static double
+msqrt(double x)
+{
+    double r = x > 1 ? x : 1;
+    int i;
+
+    if(x <= 0)
+        return 0;
+    for(i = 0; i < 64; i++)
+        r = (r + x / r) / 2;
+    return r;
+}
+
+// 2^(n/4)
+static double
+pow2q(int n)
+{
+    static const double frac[4] = {1.0, 1.18920711500272106672, 1.41421356237309504880, 1.68179283050742908606};
+    double r = frac[n & 3];
+    int e = n >> 2;
+
+    for(; e > 0; e--)
+        r *= 2;
+    for(; e < 0; e++)
+        r /= 2;
+    return r;
+}
+
+// |is|^(4/3) for every value Huffman decoding can produce
+#define POW43_SIZE (8192 + 16)
+static double pow43[POW43_SIZE];
+
+static double win[4][36];       // IMDCT windows per block type
+static double cos36[18][36];    // long block IMDCT kernel
+static double cos12[6][12];     // short block IMDCT kernel
+static double cs[8], ca[8];     // anti-alias butterflies
+static double is_l[7], is_r[7]; // intensity stereo ratios
+static double filter[64][SBLIMIT];
+
+static void init_fixed_tables(void);
+
+static void
+init_tables(void)
+{
+    static int done;
+    double c;
+    int i, k;
+
+    if(done)
+        return;
+    done = 1;
+
+    pow43[0] = 0;
+    c = 1;
+    for(i = 1; i < POW43_SIZE; i++){
+        // cube root by Newton's method, starting from the previous one
+        for(k = 0; k < 8; k++)
+            c = (2 * c + i / (c * c)) / 3;
+        pow43[i] = i * c;
+    }
+
+    for(i = 0; i < 36; i++)
+        win[0][i] = msin(PI / 36 * (i + 0.5));
+    for(i = 0; i < 18; i++)
+        win[1][i] = msin(PI / 36 * (i + 0.5));
+    for(i = 18; i < 24; i++)
+        win[1][i] = 1.0;
+    for(i = 24; i < 30; i++)
+        win[1][i] = msin(PI / 12 * (i + 0.5 - 18));
+    for(i = 30; i < 36; i++)
+        win[1][i] = 0.0;
+    for(i = 0; i < 6; i++)
+        win[3][i] = 0.0;
+    for(i = 6; i < 12; i++)
+        win[3][i] = msin(PI / 12 * (i + 0.5 - 6));
+    for(i = 12; i < 18; i++)
+        win[3][i] = 1.0;
+    for(i = 18; i < 36; i++)
+        win[3][i] = msin(PI / 36 * (i + 0.5));
+    for(i = 0; i < 12; i++)
+        win[2][i] = msin(PI / 12 * (i + 0.5));
+    for(i = 12; i < 36; i++)
+        win[2][i] = 0.0;
+
+    for(i = 0; i < 36; i++)
+        for(k = 0; k < 18; k++)
+            cos36[k][i] = mcos(PI / 72 * (2 * i + 1 + 18) * (2 * k + 1));
+    for(i = 0; i < 12; i++)
+        for(k = 0; k < 6; k++)
+            cos12[k][i] = mcos(PI / 24 * (2 * i + 1 + 6) * (2 * k + 1));
+
+    for(i = 0; i < 8; i++){
+        double sq = msqrt(1.0 + Ci[i] * Ci[i]);
+        cs[i] = 1.0 / sq;
+        ca[i] = Ci[i] / sq;
+    }
+
+    for(i = 0; i < 7; i++){
+        double s = msin(i * PI / 12), co = mcos(i * PI / 12);
+        // is_ratio = tan(is_pos * PI/12)
+        is_l[i] = s / (s + co);
+        is_r[i] = co / (s + co);
+    }
+
+    create_syn_filter(filter);
+    read_syn_window(gb_window);
+    init_fixed_tables();
+    initialize_huffman();
+}
+
+// ---------------------------------------------------------------
+// frame bitstream
+
+void
+open_bit_stream_r(Bit_stream_struc *bs, int fd)
+{
+    memset(bs, 0, sizeof(*bs));
+    bs->fd = fd;
+}
+
+static int
+fillbuf(Bit_stream_struc *bs)
+{
+    int n;
+
+    if(bs->eob)
+        return -1;
+    if((n = read(bs->fd, bs->buf, sizeof(bs->buf))) <= 0){
+        bs->eob = 1;
+        return -1;
+    }
+    bs->buf_len = n;
+    bs->buf_byte_idx = 0;
+    bs->buf_bit_idx = 8;
+    return 0;
+}
+
+unsigned int
+get1bit(Bit_stream_struc *bs)
+{
+    unsigned int bit;
+
+    if(bs->buf_byte_idx >= bs->buf_len && fillbuf(bs) < 0)
+        return 0;
+    bit = (bs->buf[bs->buf_byte_idx] >> --bs->buf_bit_idx) & 1;
+    if(bs->buf_bit_idx == 0){
+        bs->buf_byte_idx++;
+        bs->buf_bit_idx = 8;
+    }
+    bs->totbit++;
+    return bit;
+}
+
+unsigned int
+getbits(Bit_stream_struc *bs, int n)
+{
+    unsigned int val = 0;
+
+    // whole bytes when the stream is aligned, which is the usual case
+    while(n >= 8 && bs->buf_bit_idx == 8 && bs->buf_byte_idx < bs->buf_len){
+        val = (val << 8) | bs->buf[bs->buf_byte_idx++];
+        bs->totbit += 8;
+        n -= 8;
+    }
+    while(n-- > 0)
+        val = (val << 1) | get1bit(bs);
+    return val;
+}
+
+unsigned long
+sstell(Bit_stream_struc *bs)
+{
+    return bs->totbit;
+}
+
+int
+end_bs(Bit_stream_struc *bs)
+{
+    if(bs->buf_byte_idx < bs->buf_len)
+        return 0;
+    return fillbuf(bs) < 0;
+}
+
+// Find the next byte-aligned sync word. Returns 1 if found.
+int
+seek_sync(Bit_stream_struc *bs, unsigned long sync, int N)
+{
+    unsigned long maxi = (1UL << N) - 1;
+    unsigned long val;
+
+    if(bs->buf_bit_idx != 8 && bs->buf_bit_idx != 0)
+        getbits(bs, bs->buf_bit_idx);
+    val = getbits(bs, N);
+    while((val & maxi) != sync && !end_bs(bs)){
+        val <<= 8;
+        val |= getbits(bs, 8);
+    }
+    return (val & maxi) == sync;
+}
+
+static void
+skip_id3(Bit_stream_struc *bs)
+{
+    uint size;
+
+    if(end_bs(bs) || bs->buf_len < 10 ||
+       bs->buf[0] != 'I' || bs->buf[1] != 'D' || bs->buf[2] != '3')
+        return;
+    // ID3v2: "ID3", version, flags, then a 28-bit syncsafe size
+    size = (bs->buf[6] & 0x7f) << 21 | (bs->buf[7] & 0x7f) << 14 |
+           (bs->buf[8] & 0x7f) << 7 | (bs->buf[9] & 0x7f);
+    size += 10;
+    if(bs->buf[5] & 0x10)       // footer present
+        size += 10;
+    while(size > 0 && !end_bs(bs)){
+        int n = bs->buf_len - bs->buf_byte_idx;
+        if(n > size)
+            n = size;
+        bs->buf_byte_idx += n;
+        bs->totbit += n * 8;
+        size -= n;
+    }
+}
+
+void
+decode_info(Bit_stream_struc *bs, struct frame_params *fr_ps)
+{
+    layer *hdr = fr_ps->header;
+
+    hdr->version = get1bit(bs);
+    hdr->lay = 4 - getbits(bs, 2);
+    hdr->error_protection = !get1bit(bs);
+    hdr->bitrate_index = getbits(bs, 4);
+    hdr->sampling_frequency = getbits(bs, 2);
+    hdr->padding = get1bit(bs);
+    hdr->extension = get1bit(bs);
+    hdr->mode = getbits(bs, 2);
+    hdr->mode_ext = getbits(bs, 2);
+    hdr->copyright = get1bit(bs);
+    hdr->original = get1bit(bs);
+    hdr->emphasis = getbits(bs, 2);
+
+    fr_ps->actual_mode = hdr->mode;
+    fr_ps->stereo = hdr->mode == MPG_MD_MONO ? 1 : 2;
+    fr_ps->sblimit = SBLIMIT;
+    fr_ps->jsbound = SBLIMIT;
+}
+
+void
+buffer_CRC(Bit_stream_struc *bs, unsigned int *old_crc)
+{
+    *old_crc = getbits(bs, 16);
+}
+
+// Bytes of main data carried by this frame.
+int
+main_data_slots(struct frame_params fr_ps)
+{
+    layer *hdr = fr_ps.header;
+    int nSlots;
+
+    nSlots = 144000 * bitrate[hdr->bitrate_index] / s_freq[hdr->sampling_frequency];
+    if(hdr->padding)
+        nSlots++;
+    nSlots -= 4;
+    if(hdr->error_protection)
+        nSlots -= 2;
+    nSlots -= fr_ps.stereo == 1 ? 17 : 32;
+    return nSlots;
+}
+
+void
+III_get_side_info(Bit_stream_struc *bs, struct III_side_info_t *si, struct frame_params *fr_ps)
+{
+    int ch, gr, i;
+    int stereo = fr_ps->stereo;
+
+    si->main_data_begin = getbits(bs, 9);
+    si->private_bits = getbits(bs, stereo == 1 ? 5 : 3);
+    for(ch = 0; ch < stereo; ch++)
+        for(i = 0; i < 4; i++)
+            si->ch[ch].scfsi[i] = get1bit(bs);
+
+    for(gr = 0; gr < 2; gr++){
+        for(ch = 0; ch < stereo; ch++){
+            struct gr_info_s *gi = &si->ch[ch].gr[gr];
+
+            gi->part2_3_length = getbits(bs, 12);
+            gi->big_values = getbits(bs, 9);
+            if(gi->big_values > 288)
+                gi->big_values = 288;
+            gi->global_gain = getbits(bs, 8);
+            gi->scalefac_compress = getbits(bs, 4);
+            gi->window_switching_flag = get1bit(bs);
+            if(gi->window_switching_flag){
+                gi->block_type = getbits(bs, 2);
+                gi->mixed_block_flag = get1bit(bs);
+                for(i = 0; i < 2; i++)
+                    gi->table_select[i] = getbits(bs, 5);
+                gi->table_select[2] = 0;
+                for(i = 0; i < 3; i++)
+                    gi->subblock_gain[i] = getbits(bs, 3);
+                // region counts are implicit with window switching
+                if(gi->block_type == 2 && gi->mixed_block_flag == 0)
+                    gi->region0_count = 8;
+                else
+                    gi->region0_count = 7;
+                gi->region1_count = 20 - gi->region0_count;
+            } else {
+                for(i = 0; i < 3; i++)
+                    gi->table_select[i] = getbits(bs, 5);
+                gi->region0_count = getbits(bs, 4);
+                gi->region1_count = getbits(bs, 3);
+                gi->block_type = 0;
+                gi->mixed_block_flag = 0;
+                gi->subblock_gain[0] = gi->subblock_gain[1] = gi->subblock_gain[2] = 0;
+            }
+            gi->preflag = get1bit(bs);
+            gi->scalefac_scale = get1bit(bs);
+            gi->count1table_select = get1bit(bs);
+        }
+    }
+}
+
+// ---------------------------------------------------------------
+// main data: the bit reservoir
+//
+// Main data for a frame may start up to 511 bytes before the frame
+// itself, in space left over by earlier frames. resv keeps the tail
+// of the previous frames followed by this frame's main data; the
+// slack after RESV_SIZE lets a corrupt frame overrun without
+// leaving the array.
+
+#define RESV_SIZE BUFFER_SIZE
+static uchar resv[RESV_SIZE + 4096];
+static int resv_len;            // bytes of main data in resv
+static unsigned long resv_bit;  // read position, in bits
+
+unsigned int
+hgetbits(int n)
+{
+    uchar *p;
+    uint v;
+
+    if(n <= 0)
+        return 0;
+    p = resv + (resv_bit >> 3);
+    v = (uint)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+    v = (v << (resv_bit & 7)) >> (32 - n);
+    resv_bit += n;
+    return v;
+}
+
+unsigned int
+hget1bit(void)
+{
+    unsigned int bit = (resv[resv_bit >> 3] >> (7 - (resv_bit & 7))) & 1;
+    resv_bit++;
+    return bit;
+}
+
+unsigned long
+hsstell(void)
+{
+    return resv_bit;
+}
+
+void
+rewindNbits(int n)
+{
+    resv_bit -= n;
+}
+
+// Append this frame's main data and position the reader at its
+// start. Returns -1 if the reservoir does not reach back far enough,
+// as after a seek or at the start of a stream.
+static int
+fill_reservoir(Bit_stream_struc *bs, int nSlots, int main_data_begin)
+{
+    int keep, i;
+
+    if(nSlots < 0 || nSlots > RESV_SIZE - 512)
+        return -1;
+    if(resv_len + nSlots > RESV_SIZE){
+        keep = resv_len < 512 ? resv_len : 512;
+        memmove(resv, resv + resv_len - keep, keep);
+        resv_len = keep;
+    }
+    resv_bit = (unsigned long)(resv_len - main_data_begin) * 8;
+    for(i = 0; i < nSlots; i++)
+        resv[resv_len + i] = getbits(bs, 8);
+    resv_len += nSlots;
+    memset(resv + resv_len, 0, 4);
+    return main_data_begin > resv_len - nSlots ? -1 : 0;
+}
+
+// ---------------------------------------------------------------
+// scale factors and Huffman data
+
+void
+III_get_scale_factors(III_scalefac_t *scalefac, struct III_side_info_t *si, int gr, int ch, struct frame_params *fr_ps)
+{
+    struct gr_info_s *gi = &si->ch[ch].gr[gr];
+    int slen1 = slen[0][gi->scalefac_compress];
+    int slen2 = slen[1][gi->scalefac_compress];
+    int sfb, w, i;
+    static int lbound[5] = {0, 6, 11, 16, 21};
+
+    if(gi->window_switching_flag && gi->block_type == 2){
+        sfb = 0;
+        if(gi->mixed_block_flag){
+            for(; sfb < 8; sfb++)
+                (*scalefac)[ch].l[sfb] = hgetbits(slen1);
+            sfb = 3;
+        }
+        for(; sfb < 6; sfb++)
+            for(w = 0; w < 3; w++)
+                (*scalefac)[ch].s[w][sfb] = hgetbits(slen1);
+        for(; sfb < 12; sfb++)
+            for(w = 0; w < 3; w++)
+                (*scalefac)[ch].s[w][sfb] = hgetbits(slen2);
+        for(w = 0; w < 3; w++)
+            (*scalefac)[ch].s[w][12] = 0;
+    } else {
+        for(i = 0; i < 4; i++){
+            // with scfsi set, granule 1 reuses granule 0's factors
+            if(si->ch[ch].scfsi[i] && gr == 1)
+                continue;
+            for(sfb = lbound[i]; sfb < lbound[i+1]; sfb++)
+                (*scalefac)[ch].l[sfb] = hgetbits(i < 2 ? slen1 : slen2);
+        }
+        (*scalefac)[ch].l[21] = 0;
+        (*scalefac)[ch].l[22] = 0;
+    }
+}
+
+// number of possibly non-zero lines per channel, set by
+// III_hufman_decode and used to skip work on the silent top bands
+static int nonzero[2];
+
+void
+III_hufman_decode(long int is[SBLIMIT][SSLIMIT], struct III_side_info_t *si, int ch, int gr, int part2_start, struct frame_params *fr_ps)
+{
+    struct gr_info_s *gi = &si->ch[ch].gr[gr];
+    long *out = &is[0][0];
+    unsigned long end = part2_start + gi->part2_3_length;
+    int sf = fr_ps->header->sampling_frequency;
+    int region1Start, region2Start;
+    int i, x, y, v, w;
+    struct huffcodetab *h;
+
+    if(gi->window_switching_flag && gi->block_type == 2){
+        region1Start = 36;
+        region2Start = 576;
+    } else {
+        i = gi->region0_count + gi->region1_count + 2;
+        region1Start = sfBandIndex[sf].l[gi->region0_count + 1];
+        region2Start = sfBandIndex[sf].l[i < 22 ? i : 22];
+    }
+
+    // big values region
+    for(i = 0; i < gi->big_values * 2; i += 2){
+        if(i < region1Start)
+            h = &ht[gi->table_select[0]];
+        else if(i < region2Start)
+            h = &ht[gi->table_select[1]];
+        else
+            h = &ht[gi->table_select[2]];
+        huffman_decoder(h, &x, &y, &v, &w);
+        out[i] = x;
+        out[i+1] = y;
+    }
+
+    // count1 region: quadruples of -1, 0, 1
+    h = &ht[gi->count1table_select + 32];
+    while(hsstell() < end && i + 4 <= SBLIMIT * SSLIMIT){
+        huffman_decoder(h, &x, &y, &v, &w);
+        out[i] = v;
+        out[i+1] = w;
+        out[i+2] = x;
+        out[i+3] = y;
+        i += 4;
+    }
+    // a quadruple that straddles the end is not part of this granule
+    if(hsstell() > end){
+        i -= 4;
+        rewindNbits(hsstell() - end);
+    }
+    // dismiss stuffing bits
+    resv_bit = end;
+
+    nonzero[ch] = i;
+    for(; i < SBLIMIT * SSLIMIT; i++)
+        out[i] = 0;
+}
+
+// ---------------------------------------------------------------
+// requantization and stereo
+
+void
+III_dequantize_sample(long int is[SBLIMIT][SSLIMIT], double xr[SBLIMIT][SSLIMIT], III_scalefac_t *scalefac, struct gr_info_s *gr_info, int ch, struct frame_params *fr_ps)
+{
+    int sf = fr_ps->header->sampling_frequency;
+    long *in = &is[0][0];
+    double *out = &xr[0][0];
+    int gain = gr_info->global_gain - 210;
+    int shift = gr_info->scalefac_scale ? 4 : 2;   // in quarter powers of 2
+    int n = nonzero[ch];
+    int cb, w, i, width, start, end, first_short;
+    double g;
+
+    memset(out, 0, sizeof(double) * SBLIMIT * SSLIMIT);
+
+    if(gr_info->window_switching_flag && gr_info->block_type == 2){
+        first_short = 0;
+        if(gr_info->mixed_block_flag){
+            // two long subbands, scalefactor bands 0..7
+            for(cb = 0; cb < 8; cb++){
+                g = pow2q(gain - shift * (*scalefac)[ch].l[cb]);
+                end = sfBandIndex[sf].l[cb+1];
+                for(i = sfBandIndex[sf].l[cb]; i < end && i < n; i++)
+                    out[i] = in[i] < 0 ? -g * pow43[-in[i]] : g * pow43[in[i]];
+            }
+            first_short = 3;
+        }
+        for(cb = first_short; cb < 13; cb++){
+            width = sfBandIndex[sf].s[cb+1] - sfBandIndex[sf].s[cb];
+            start = sfBandIndex[sf].s[cb] * 3;
+            for(w = 0; w < 3; w++){
+                g = pow2q(gain - 8 * (int)gr_info->subblock_gain[w] -
+                          shift * (*scalefac)[ch].s[w][cb]);
+                end = start + (w + 1) * width;
+                for(i = start + w * width; i < end && i < n; i++)
+                    out[i] = in[i] < 0 ? -g * pow43[-in[i]] : g * pow43[in[i]];
+            }
+        }
+    } else {
+        for(cb = 0; cb < 22; cb++){
+            g = pow2q(gain - shift * ((*scalefac)[ch].l[cb] +
+                                       gr_info->preflag * pretab[cb]));
+            end = sfBandIndex[sf].l[cb+1];
+            for(i = sfBandIndex[sf].l[cb]; i < end && i < n; i++)
+                out[i] = in[i] < 0 ? -g * pow43[-in[i]] : g * pow43[in[i]];
+        }
+    }
+}
+
+// Short blocks are coded band by band, window by window; put them
+// back in subband order, each window's lines interleaved.
+void
+III_reorder(double xr[SBLIMIT][SSLIMIT], double ro[SBLIMIT][SSLIMIT], struct gr_info_s *gr_info, struct frame_params *fr_ps)
+{
+    int sf = fr_ps->header->sampling_frequency;
+    double *in = &xr[0][0], *out = &ro[0][0];
+    int sfb, sfb_start, sfb_lines, w, f;
+
+    if(!(gr_info->window_switching_flag && gr_info->block_type == 2)){
+        memmove(out, in, sizeof(double) * SBLIMIT * SSLIMIT);
+        return;
+    }
+    memset(out, 0, sizeof(double) * SBLIMIT * SSLIMIT);
+    sfb = 0;
+    if(gr_info->mixed_block_flag){
+        // no reorder for the two long subbands
+        memmove(out, in, sizeof(double) * 2 * SSLIMIT);
+        sfb = 3;
+    }
+    for(; sfb < 13; sfb++){
+        sfb_start = sfBandIndex[sf].s[sfb];
+        sfb_lines = sfBandIndex[sf].s[sfb+1] - sfb_start;
+        for(w = 0; w < 3; w++)
+            for(f = 0; f < sfb_lines; f++)
+                out[sfb_start * 3 + w + f * 3] = in[sfb_start * 3 + w * sfb_lines + f];
+    }
+}
+
+// Highest scalefactor band of window w (short blocks) holding a
+// non-zero right channel line, or first - 1 if there is none.
+static int
+last_short_sfb(double *r, int sf, int w, int first)
+{
+    int sfb, i, lines, start;
+
+    for(sfb = 12; sfb >= first; sfb--){
+        lines = sfBandIndex[sf].s[sfb+1] - sfBandIndex[sf].s[sfb];
+        start = sfBandIndex[sf].s[sfb] * 3 + w * lines;
+        for(i = 0; i < lines; i++)
+            if(r[start + i] != 0.0)
+                return sfb;
+    }
+    return first - 1;
+}
+
+// Long scalefactor band holding the last non-zero right channel
+// line below limit, or -1 if there is none.
+static int
+last_long_sfb(double *r, int sf, int limit)
+{
+    int i, sfb;
+
+    for(i = limit - 1; i >= 0 && r[i] == 0.0; i--)
+        ;
+    if(i < 0)
+        return -1;
+    for(sfb = 0; sfBandIndex[sf].l[sfb+1] <= i; sfb++)
+        ;
+    return sfb;
+}
+
+void
+III_stereo(double xr[2][SBLIMIT][SSLIMIT], double lr[2][SBLIMIT][SSLIMIT], III_scalefac_t *scalefac, struct gr_info_s *gr_info, struct frame_params *fr_ps)
+{
+    int sf = fr_ps->header->sampling_frequency;
+    int ms_stereo = fr_ps->header->mode == MPG_MD_JOINT_STEREO && (fr_ps->header->mode_ext & 0x2);
+    int i_stereo = fr_ps->header->mode == MPG_MD_JOINT_STEREO && (fr_ps->header->mode_ext & 0x1);
+    double *l = &xr[0][0][0], *r = &xr[1][0][0];
+    double *ol = &lr[0][0][0], *or = &lr[1][0][0];
+    static char is_pos[SBLIMIT * SSLIMIT];
+    int i, n, sfb, w, lines, start, last;
+
+    if(fr_ps->stereo == 1){
+        memmove(ol, l, sizeof(double) * SBLIMIT * SSLIMIT);
+        return;
+    }
+
+    // is_pos[i] is the intensity position of line i, 7 if the line
+    // is not intensity coded
+    memset(is_pos, 7, sizeof(is_pos));
+    if(i_stereo){
+        if(gr_info->window_switching_flag && gr_info->block_type == 2){
+            int first = gr_info->mixed_block_flag ? 3 : 0;
+            int max_sfb = 0;
+
+            for(w = 0; w < 3; w++){
+                last = last_short_sfb(r, sf, w, first);
+                if(last + 1 > max_sfb)
+                    max_sfb = last + 1;
+                for(sfb = last + 1; sfb < 13; sfb++){
+                    lines = sfBandIndex[sf].s[sfb+1] - sfBandIndex[sf].s[sfb];
+                    start = sfBandIndex[sf].s[sfb] * 3 + w * lines;
+                    // the last band has no factor of its own
+                    n = (*scalefac)[1].s[w][sfb < 12 ? sfb : 11];
+                    if(sfb == 12 && last == 11)
+                        n = 7;
+                    memset(is_pos + start, n, lines);
+                }
+            }
+            if(gr_info->mixed_block_flag && max_sfb <= 3){
+                last = last_long_sfb(r, sf, 36);
+                for(sfb = last + 1; sfb < 8; sfb++){
+                    start = sfBandIndex[sf].l[sfb];
+                    memset(is_pos + start, (*scalefac)[1].l[sfb], sfBandIndex[sf].l[sfb+1] - start);
+                }
+            }
+        } else {
+            last = last_long_sfb(r, sf, SBLIMIT * SSLIMIT);
+            for(sfb = last + 1; sfb < 22; sfb++){
+                start = sfBandIndex[sf].l[sfb];
+                n = (*scalefac)[1].l[sfb < 21 ? sfb : 20];
+                if(sfb == 21 && last == 20)
+                    n = 7;
+                memset(is_pos + start, n, sfBandIndex[sf].l[sfb+1] - start);
+            }
+        }
+    }
+
+    n = nonzero[0] > nonzero[1] ? nonzero[0] : nonzero[1];
+    for(i = 0; i < SBLIMIT * SSLIMIT; i++){
+        if(is_pos[i] < 7){
+            double v = l[i];
+            ol[i] = v * is_l[(int)is_pos[i]];
+            or[i] = v * is_r[(int)is_pos[i]];
+        } else if(ms_stereo){
+            double m = l[i], s = r[i];
+            ol[i] = (m + s) * 0.70710678118654752440;
+            or[i] = (m - s) * 0.70710678118654752440;
+        } else {
+            ol[i] = l[i];
+            or[i] = r[i];
+        }
+    }
+    if(i_stereo)
+        n = SBLIMIT * SSLIMIT;
+    nonzero[0] = nonzero[1] = n;
+}
+
+// ---------------------------------------------------------------
+// anti-alias, IMDCT and polyphase synthesis
+
+void
+III_antialias(double xr[SBLIMIT][SSLIMIT], double hybridIn[SBLIMIT][SSLIMIT], struct gr_info_s *gr_info, struct frame_params *fr_ps)
+{
+    int sblim, sb, ss;
+    double bu, bd;
+
+    memmove(hybridIn, xr, sizeof(double) * SBLIMIT * SSLIMIT);
+    if(gr_info->window_switching_flag && gr_info->block_type == 2 &&
+       !gr_info->mixed_block_flag)
+        return;
+    if(gr_info->window_switching_flag && gr_info->mixed_block_flag &&
+       gr_info->block_type == 2)
+        sblim = 1;
+    else
+        sblim = SBLIMIT - 1;
+
+    for(sb = 0; sb < sblim; sb++){
+        for(ss = 0; ss < 8; ss++){
+            bu = xr[sb][17-ss];
+            bd = xr[sb+1][ss];
+            hybridIn[sb][17-ss] = bu * cs[ss] - bd * ca[ss];
+            hybridIn[sb+1][ss] = bd * cs[ss] + bu * ca[ss];
+        }
+    }
+}
+
+void
+inv_mdct(double in[18], double out[36], int block_type)
+{
+    int i, p, m;
+    double sum, tmp[12];
+
+    if(block_type == 2){
+        for(p = 0; p < 36; p++)
+            out[p] = 0.0;
+        for(i = 0; i < 3; i++){
+            for(p = 0; p < 12; p++){
+                sum = 0.0;
+                for(m = 0; m < 6; m++)
+                    sum += in[i + 3 * m] * cos12[m][p];
+                tmp[p] = sum * win[2][p];
+            }
+            for(p = 0; p < 12; p++)
+                out[6 * i + p + 6] += tmp[p];
+        }
+    } else {
+        for(p = 0; p < 36; p++){
+            sum = 0.0;
+            for(m = 0; m < 18; m++)
+                sum += in[m] * cos36[m][p];
+            out[p] = sum * win[block_type][p];
+        }
+    }
+}
+
+static double prevblck[2][SBLIMIT][SSLIMIT];
+
+void
+III_hybrid(double fsIn[SSLIMIT], double tsOut[SSLIMIT], int sb, int ch, struct gr_info_s *gr_info, struct frame_params *fr_ps)
+{
+    double rawout[36];
+    int bt, ss;
+
+    bt = (gr_info->window_switching_flag && gr_info->mixed_block_flag && sb < 2) ?
+         0 : gr_info->block_type;
+    inv_mdct(fsIn, rawout, bt);
+
+    // overlap the first half with the saved second half
+    for(ss = 0; ss < SSLIMIT; ss++){
+        tsOut[ss] = rawout[ss] + prevblck[ch][sb][ss];
+        prevblck[ch][sb][ss] = rawout[ss + 18];
+    }
+}
+
+// Matrixing coefficients N[i][k] = cos((16 + i)(2k + 1) PI / 64).
+void
+create_syn_filter(double filter[64][SBLIMIT])
+{
+    int i, k;
+
+    for(i = 0; i < 64; i++)
+        for(k = 0; k < SBLIMIT; k++)
+            filter[i][k] = mcos((PI / 64 * i + PI / 4) * (2 * k + 1));
+}
+
+// The synthesis window D[i] of table 3-B.3. D is symmetric around
+// 256 and changes sign every 64 samples relative to intwinbase.
+void
+read_syn_window(double window[HAN_SIZE])
+{
+    int i, v;
+
+    for(i = 0; i < HAN_SIZE; i++){
+        v = i <= 256 ? intwinbase[i] : intwinbase[512 - i];
+        if((i / 64) & 1)
+            v = -v;
+        window[i] = v / 65536.0;
+    }
+}
+
+static double buf[2][2 * HAN_SIZE];
+static int bufOffset[2] = {64, 64};
+
+int
+SubBandSynthesis(double *bandPtr, int channel, short *samples)
+{
+    double *bufOffsetPtr, sum;
+    int i, j, k, clip = 0;
+    long foo;
+
+    bufOffset[channel] = (bufOffset[channel] - 64) & 0x3ff;
+    bufOffsetPtr = &buf[channel][bufOffset[channel]];
+
+    for(i = 0; i < 64; i++){
+        sum = 0;
+        for(k = 0; k < SBLIMIT; k++)
+            sum += bandPtr[k] * filter[i][k];
+        bufOffsetPtr[i] = sum;
+    }
+
+    // S(j) = sum over i of D(j + 32i) * V(j + 32i + ((i + 1) >> 1) * 64)
+    for(j = 0; j < SBLIMIT; j++){
+        sum = 0;
+        for(i = 0; i < 16; i++){
+            k = j + (i << 5);
+            sum += gb_window[k] *
+                   buf[channel][((k + (((i + 1) >> 1) << 6)) + bufOffset[channel]) & 0x3ff];
+        }
+        sum *= SCALE;
+        foo = sum > 0 ? (long)(sum + 0.5) : (long)(sum - 0.5);
+        if(foo >= SCALE){
+            samples[j] = SCALE - 1;
+            clip++;
+        } else if(foo < -SCALE){
+            samples[j] = -SCALE;
+            clip++;
+        } else {
+            samples[j] = foo;
+        }
+    }
+    return clip;
+}
+
+// ---------------------------------------------------------------
+// fixed-point IMDCT and synthesis
+//
+// With soft float the IMDCT and the polyphase filterbank cost more
+// than everything else together, so by default they run on Q-format
+// integers: signals carry FRAC_BITS fraction bits, coefficients
+// COEF_BITS. Products are summed in 64 bits and shifted once per
+// output. The double versions above remain the reference that
+// mp3test compares against.
+
+int mp3_use_double;
+
+#define COEF(x) ((fixed_t)((x) * (1 << COEF_BITS) + ((x) < 0 ? -0.5 : 0.5)))
+
+static fixed_t imdct36[18][18];     // DCT-IV kernel, long blocks
+static fixed_t imdct12[6][6];       // DCT-IV kernel, short blocks
+static fixed_t winf[4][36];
+static fixed_t dct_c32[16], dct_c16[8], dct_c8[4], dct_c4[2], dct_c2[1];
+static fixed_t dwin[HAN_SIZE];
+
+static fixed_t prevblckf[2][SBLIMIT][SSLIMIT];
+static fixed_t buff[2][2 * HAN_SIZE];
+static int bufOffsetf[2] = {64, 64};
+
+static void
+init_fixed_tables(void)
+{
+    int i, k;
+
+    for(i = 0; i < 18; i++)
+        for(k = 0; k < 18; k++)
+            imdct36[i][k] = COEF(mcos(PI / 72 * (2 * i + 1) * (2 * k + 1)));
+    for(i = 0; i < 6; i++)
+        for(k = 0; k < 6; k++)
+            imdct12[i][k] = COEF(mcos(PI / 24 * (2 * i + 1) * (2 * k + 1)));
+    for(i = 0; i < 4; i++)
+        for(k = 0; k < 36; k++)
+            winf[i][k] = COEF(win[i][k]);
+
+    // 1 / (2 cos((2k + 1) PI / 2N)) for each stage of the DCT
+    for(k = 0; k < 16; k++)
+        dct_c32[k] = COEF(0.5 / mcos((2 * k + 1) * PI / 64));
+    for(k = 0; k < 8; k++)
+        dct_c16[k] = COEF(0.5 / mcos((2 * k + 1) * PI / 32));
+    for(k = 0; k < 4; k++)
+        dct_c8[k] = COEF(0.5 / mcos((2 * k + 1) * PI / 16));
+    for(k = 0; k < 2; k++)
+        dct_c4[k] = COEF(0.5 / mcos((2 * k + 1) * PI / 8));
+    dct_c2[0] = COEF(0.5 / mcos(PI / 4));
+
+    for(i = 0; i < HAN_SIZE; i++)
+        dwin[i] = COEF(gb_window[i]);
+}
+
+static inline fixed_t
+fmul(fixed_t a, fixed_t b)
+{
+    return ((long)a * b) >> COEF_BITS;
+}
+
+// The IMDCT of 2N outputs is an N-point DCT-IV, y[q], unfolded:
+// out[p] = y[p + N/2], -y[3N/2 - 1 - p], -y[p - 3N/2] for the three
+// parts. That halves the multiplies of the direct form.
+void
+inv_mdct_fixed(fixed_t in[18], fixed_t out[36], int block_type)
+{
+    fixed_t y[18];
+    long sum;
+    int i, p, m;
+
+    if(block_type == 2){
+        for(p = 0; p < 36; p++)
+            out[p] = 0;
+        for(i = 0; i < 3; i++){
+            for(p = 0; p < 6; p++){
+                sum = 0;
+                for(m = 0; m < 6; m++)
+                    sum += (long)in[i + 3 * m] * imdct12[p][m];
+                y[p] = sum >> COEF_BITS;
+            }
+            for(p = 0; p < 3; p++)
+                out[6 * i + 6 + p] += fmul(y[p + 3], winf[2][p]);
+            for(p = 3; p < 9; p++)
+                out[6 * i + 6 + p] += fmul(-y[8 - p], winf[2][p]);
+            for(p = 9; p < 12; p++)
+                out[6 * i + 6 + p] += fmul(-y[p - 9], winf[2][p]);
+        }
+        return;
+    }
+
+    for(p = 0; p < 18; p++){
+        sum = 0;
+        for(m = 0; m < 18; m++)
+            sum += (long)in[m] * imdct36[p][m];
+        y[p] = sum >> COEF_BITS;
+    }
+    for(p = 0; p < 9; p++)
+        out[p] = fmul(y[p + 9], winf[block_type][p]);
+    for(p = 9; p < 27; p++)
+        out[p] = fmul(-y[26 - p], winf[block_type][p]);
+    for(p = 27; p < 36; p++)
+        out[p] = fmul(-y[p - 27], winf[block_type][p]);
+}
+
+void
+III_hybrid_fixed(fixed_t fsIn[SSLIMIT], fixed_t tsOut[SSLIMIT], int sb, int ch, struct gr_info_s *gr_info, struct frame_params *fr_ps)
+{
+    fixed_t rawout[36];
+    fixed_t *prev = prevblckf[ch][sb];
+    int bt, ss;
+
+    // silent subbands, most of the upper half, only flush the overlap
+    for(ss = 0; ss < SSLIMIT && fsIn[ss] == 0; ss++)
+        ;
+    if(ss == SSLIMIT){
+        for(ss = 0; ss < SSLIMIT; ss++){
+            tsOut[ss] = prev[ss];
+            prev[ss] = 0;
+        }
+        return;
+    }
+
+    bt = (gr_info->window_switching_flag && gr_info->mixed_block_flag && sb < 2) ?
+         0 : gr_info->block_type;
+    inv_mdct_fixed(fsIn, rawout, bt);
+    for(ss = 0; ss < SSLIMIT; ss++){
+        tsOut[ss] = rawout[ss] + prev[ss];
+        prev[ss] = rawout[ss + 18];
+    }
+}
+
+// N-point DCT-II, X[m] = sum x[k] cos((2k + 1) m PI / 2N), by Lee's
+// recursion: the even outputs are the N/2-point DCT of the folded
+// sums, the odd ones come from the DCT of the scaled differences.
+// x is used as scratch.
+static void
+dct_fixed(fixed_t *x, fixed_t *X, int n, const fixed_t *c)
+{
+    fixed_t g[16], h[16], G[16], H[16];
+    const fixed_t *next;
+    int k, half = n / 2;
+
+    if(n == 1){
+        X[0] = x[0];
+        return;
+    }
+    for(k = 0; k < half; k++){
+        g[k] = x[k] + x[n - 1 - k];
+        h[k] = fmul(x[k] - x[n - 1 - k], c[k]);
+    }
+    next = n == 32 ? dct_c16 : n == 16 ? dct_c8 : n == 8 ? dct_c4 : dct_c2;
+    dct_fixed(g, G, half, next);
+    dct_fixed(h, H, half, next);
+    for(k = 0; k < half - 1; k++){
+        X[2 * k] = G[k];
+        X[2 * k + 1] = H[k] + H[k + 1];
+    }
+    X[n - 2] = G[half - 1];
+    X[n - 1] = H[half - 1];
+}
+
+void
+dct32_fixed(fixed_t in[32], fixed_t out[32])
+{
+    fixed_t x[32];
+
+    memmove(x, in, sizeof(x));
+    dct_fixed(x, out, 32, dct_c32);
+}
+
+// Same filterbank as SubBandSynthesis(), but the 64x32 matrixing
+// is a 32-point DCT: with X = DCT-II(bandPtr), the 64 new V values
+// are X[i+16], 0, -X[48-i] and -X[i-48].
+int
+SubBandSynthesis_fixed(fixed_t *bandPtr, int channel, short *samples)
+{
+    fixed_t X[32], *v, *b = buff[channel];
+    int i, j, k, off, clip = 0;
+    long sum;
+
+    off = bufOffsetf[channel] = (bufOffsetf[channel] - 64) & 0x3ff;
+    v = &b[off];
+    dct32_fixed(bandPtr, X);
+    for(i = 0; i < 16; i++)
+        v[i] = X[i + 16];
+    v[16] = 0;
+    for(i = 17; i < 48; i++)
+        v[i] = -X[48 - i];
+    for(i = 48; i < 64; i++)
+        v[i] = -X[i - 48];
+
+    for(j = 0; j < SBLIMIT; j++){
+        sum = 0;
+        for(i = 0; i < 16; i++){
+            k = j + (i << 5);
+            sum += (long)dwin[k] * b[(k + (((i + 1) >> 1) << 6) + off) & 0x3ff];
+        }
+        // Q(FRAC_BITS + COEF_BITS) to 16 bits, rounded
+        sum = (sum + (1L << (FRAC_BITS + COEF_BITS - 16))) >> (FRAC_BITS + COEF_BITS - 15);
+        if(sum >= SCALE){
+            samples[j] = SCALE - 1;
+            clip++;
+        } else if(sum < -SCALE){
+            samples[j] = -SCALE;
+            clip++;
+        } else {
+            samples[j] = sum;
+        }
+    }
+    return clip;
+}
+
+static fixed_t
+to_fixed(double x)
+{
+    x *= 1 << FRAC_BITS;
+    if(x >= 2147483647.0)
+        return 2147483647;
+    if(x <= -2147483647.0)
+        return -2147483647;
+    return (fixed_t)(x < 0 ? x - 0.5 : x + 0.5);
+}
+
+// Interleave num rows of 32 samples as 16-bit stereo and pass them
+// on. The AC97 card only plays stereo, so mono is duplicated.
+void
+out_fifo(short pcm_sample[2][SSLIMIT][SBLIMIT], int num, struct frame_params *fr_ps, unsigned long *psampFrames)
+{
+    static short out[2 * SSLIMIT * SBLIMIT];
+    int i, j, n = 0;
+    int r = fr_ps->stereo == 2;
+
+    for(i = 0; i < num; i++){
+        for(j = 0; j < SBLIMIT; j++){
+            out[n++] = pcm_sample[0][i][j];
+            out[n++] = pcm_sample[r][i][j];
+        }
+    }
+    *psampFrames += num * SBLIMIT;
+    if(pcm_sink)
+        pcm_sink(out, n * sizeof(short));
+}
+
+// ---------------------------------------------------------------
+
+// IMDCT, frequency inversion and synthesis of one granule of one
+// channel, in double precision or in fixed point.
+static void
+synth_double(double hybridIn[SBLIMIT][SSLIMIT], int ch, struct gr_info_s *gi, struct frame_params *fr_ps, short pcm[SSLIMIT][SBLIMIT])
+{
+    static double hybridOut[SBLIMIT][SSLIMIT];
+    double polyPhaseIn[SBLIMIT];
+    int sb, ss;
+
+    for(sb = 0; sb < SBLIMIT; sb++)
+        III_hybrid(hybridIn[sb], hybridOut[sb], sb, ch, gi, fr_ps);
+
+    // frequency inversion for the polyphase filterbank
+    for(sb = 1; sb < SBLIMIT; sb += 2)
+        for(ss = 1; ss < SSLIMIT; ss += 2)
+            hybridOut[sb][ss] = -hybridOut[sb][ss];
+
+    for(ss = 0; ss < SSLIMIT; ss++){
+        for(sb = 0; sb < SBLIMIT; sb++)
+            polyPhaseIn[sb] = hybridOut[sb][ss];
+        SubBandSynthesis(polyPhaseIn, ch, pcm[ss]);
+    }
+}
+
+static void
+synth_fixed(double hybridIn[SBLIMIT][SSLIMIT], int ch, struct gr_info_s *gi, struct frame_params *fr_ps, short pcm[SSLIMIT][SBLIMIT])
+{
+    static fixed_t in[SBLIMIT][SSLIMIT];
+    static fixed_t hybridOut[SBLIMIT][SSLIMIT];
+    fixed_t polyPhaseIn[SBLIMIT];
+    int sb, ss;
+
+    for(sb = 0; sb < SBLIMIT; sb++)
+        for(ss = 0; ss < SSLIMIT; ss++)
+            in[sb][ss] = hybridIn[sb][ss] == 0.0 ? 0 : to_fixed(hybridIn[sb][ss]);
+    for(sb = 0; sb < SBLIMIT; sb++)
+        III_hybrid_fixed(in[sb], hybridOut[sb], sb, ch, gi, fr_ps);
+
+    for(sb = 1; sb < SBLIMIT; sb += 2)
+        for(ss = 1; ss < SSLIMIT; ss += 2)
+            hybridOut[sb][ss] = -hybridOut[sb][ss];
+
+    for(ss = 0; ss < SSLIMIT; ss++){
+        for(sb = 0; sb < SBLIMIT; sb++)
+            polyPhaseIn[sb] = hybridOut[sb][ss];
+        SubBandSynthesis_fixed(polyPhaseIn, ch, pcm[ss]);
+    }
+}
+
+// Forget all inter-frame state: the bit reservoir and the overlap
+// and filterbank history. Call before decoding from a new position.
+void
+mp3_reset(void)
+{
+    resv_len = 0;
+    resv_bit = 0;
+    memset(prevblck, 0, sizeof(prevblck));
+    memset(buf, 0, sizeof(buf));
+    bufOffset[0] = bufOffset[1] = 64;
+    memset(prevblckf, 0, sizeof(prevblckf));
+    memset(buff, 0, sizeof(buff));
+    bufOffsetf[0] = bufOffsetf[1] = 64;
+}
+
+int
+mp3_decode_frame(Bit_stream_struc *bs, struct frame_params *fr_ps)
+{
+    static layer info;
+    static struct III_side_info_t III_side_info;
+    static III_scalefac_t III_scalefac;
+    static long int is[SBLIMIT][SSLIMIT];
+    static double ro[2][SBLIMIT][SSLIMIT];
+    static double lr[2][SBLIMIT][SSLIMIT];
+    static double re[SBLIMIT][SSLIMIT];
+    static double hybridIn[SBLIMIT][SSLIMIT];
+    static short pcm_sample[2][SSLIMIT][SBLIMIT];
+    unsigned long sampFrames = 0;
+    unsigned int old_crc;
+    int gr, ch, nSlots;
+
+    init_tables();
+    fr_ps->header = &info;
+    if(sstell(bs) == 0)
+        skip_id3(bs);
+
+again:
+    if(!seek_sync(bs, SYNC_WORD, SYNC_WORD_LNGTH))
+        return 0;
+    decode_info(bs, fr_ps);
+    // only MPEG-1 Layer III with a fixed bitrate; anything else is
+    // taken for a false sync inside the data
+    if(info.version != MPEG_AUDIO_ID || info.lay != 3 ||
+       info.bitrate_index == 0 || info.bitrate_index == 15 ||
+       info.sampling_frequency == 3)
+        goto again;
+    if(info.error_protection)
+        buffer_CRC(bs, &old_crc);
+    III_get_side_info(bs, &III_side_info, fr_ps);
+    nSlots = main_data_slots(*fr_ps);
+    if(fill_reservoir(bs, nSlots, III_side_info.main_data_begin) < 0)
+        goto again;
+
+    for(gr = 0; gr < 2; gr++){
+        for(ch = 0; ch < fr_ps->stereo; ch++){
+            int part2_start = hsstell();
+            III_get_scale_factors(&III_scalefac, &III_side_info, gr, ch, fr_ps);
+            III_hufman_decode(is, &III_side_info, ch, gr, part2_start, fr_ps);
+            III_dequantize_sample(is, ro[ch], &III_scalefac,
+                                  &III_side_info.ch[ch].gr[gr], ch, fr_ps);
+        }
+        III_stereo(ro, lr, &III_scalefac, &III_side_info.ch[0].gr[gr], fr_ps);
+
+        for(ch = 0; ch < fr_ps->stereo; ch++){
+            struct gr_info_s *gi = &III_side_info.ch[ch].gr[gr];
+
+            III_reorder(lr[ch], re, gi, fr_ps);
+            III_antialias(re, hybridIn, gi, fr_ps);
+            if(mp3_use_double)
+                synth_double(hybridIn, ch, gi, fr_ps, pcm_sample[ch]);
+            else
+                synth_fixed(hybridIn, ch, gi, fr_ps, pcm_sample[ch]);
+        }
+        out_fifo(pcm_sample, SSLIMIT, fr_ps, &sampFrames);
+    }
+    return sampFrames;
+}
@@ -0,0 +1,126 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+#include "user/decode.h"
+
+// mp3test [file.mp3 [frames]]
+//
+// Decode the first frames of file.mp3 twice, once with the double
+// precision reference filterbank and once with the fixed-point one,
+// and compare the PCM. The fixed-point path must stay within a few
+// LSBs of the reference: the test fails below MIN_SNR dB.
+
+#define DEFAULT_FILE   "/media/test2.mp3"  // on the media disk
+#define DEFAULT_FRAMES 200
+#define FRAME_BYTES    (1152 * 4)   // one MPEG-1 frame, 16-bit stereo
+#define MIN_SNR        80
+
+static short *ref;
+static int nref, nout, nsame, maxdiff;
+static double sig, err;
+
+static void
+store(const short *pcm, int nbytes)
+{
+    memmove(ref + nref, pcm, nbytes);
+    nref += nbytes / 2;
+}
+
+static void
+compare(const short *pcm, int nbytes)
+{
+    int i, d, n = nbytes / 2;
+
+    for(i = 0; i < n && nout < nref; i++, nout++){
+        d = pcm[i] - ref[nout];
+        if(d == 0)
+            nsame++;
+        if(d < 0)
+            d = -d;
+        if(d > maxdiff)
+            maxdiff = d;
+        sig += (double)ref[nout] * ref[nout];
+        err += (double)d * d;
+    }
+}
+
+// 10 log10(x) for x >= 1, without libm: whole decades by division,
+// the rest from ln(x) = 2 atanh((x - 1) / (x + 1)).
+static int
+decibels(double x)
+{
+    double t, t2, term, ln = 0;
+    int k, db = 0;
+
+    while(x >= 10){
+        x /= 10;
+        db += 10;
+    }
+    t = (x - 1) / (x + 1);
+    t2 = t * t;
+    term = t;
+    for(k = 1; k < 40; k += 2){
+        ln += term / k;
+        term *= t2;
+    }
+    return db + (int)(2 * ln * 4.342944819);   // 10 / ln(10)
+}
+
+static int
+run(char *file, int frames, void (*sink)(const short*, int))
+{
+    Bit_stream_struc *bs;
+    struct frame_params fr_ps;
+    int fd, n;
+
+    if((fd = open(file, O_RDONLY)) < 0){
+        printf("mp3test: cannot open %s\n", file);
+        return -1;
+    }
+    bs = malloc(sizeof(*bs));
+    open_bit_stream_r(bs, fd);
+    mp3_reset();
+    pcm_sink = sink;
+    for(n = 0; n < frames && mp3_decode_frame(bs, &fr_ps) > 0; n++)
+        ;
+    free(bs);
+    close(fd);
+    return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+    char *file = argc > 1 ? argv[1] : DEFAULT_FILE;
+    int frames = argc > 2 ? atoi(argv[2]) : DEFAULT_FRAMES;
+    int n, snr;
+
+    printf("mp3test starting\n");
+    if((ref = malloc(frames * FRAME_BYTES)) == 0){
+        printf("mp3test: out of memory\n");
+        exit(1);
+    }
+
+    mp3_use_double = 1;
+    if((n = run(file, frames, store)) <= 0){
+        printf("mp3test: no frames decoded, FAILED\n");
+        exit(1);
+    }
+    mp3_use_double = 0;
+    if(run(file, n, compare) != n || nout != nref){
+        printf("mp3test: fixed-point decode produced %d of %d samples, FAILED\n",
+               nout, nref);
+        exit(1);
+    }
+
+    snr = err == 0 ? 999 : decibels(sig / err < 1 ? 1 : sig / err);
+    printf("%d frames, %d samples: %d bit-exact, max diff %d, SNR %d dB\n",
+           n, nref, nsame, maxdiff, snr);
+    if(snr < MIN_SNR){
+        printf("mp3test: FAILED\n");
+        exit(1);
+    }
+    printf("mp3test: OK\n");
+    exit(0);
+}
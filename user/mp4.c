@@ -0,0 +1,909 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+#include "user/mp4.h"
+
+// MP4 demuxing.
+//
+// An MP4 file is a sequence of boxes, {size, type, payload}, nested
+// inside each other. All the per-sample tables live in the moov box,
+// which is read into memory once and walked in place with spans.
+// From the tables each track gets a compact sample index; the moov
+// buffer is freed as soon as the index is built.
+
+uint
+span_left(const struct span *s)
+{
+    return s->size - s->pos;
+}
+
+int
+span_skip(struct span *s, uint n)
+{
+    if(n > span_left(s)){
+        s->pos = s->size;
+        s->error = 1;
+        return -1;
+    }
+    s->pos += n;
+    return 0;
+}
+
+uint
+span_u8(struct span *s)
+{
+    if(span_left(s) < 1){
+        s->error = 1;
+        return 0;
+    }
+    return s->data[s->pos++];
+}
+
+uint
+span_u16(struct span *s)
+{
+    const uchar *p = s->data + s->pos;
+
+    if(span_skip(s, 2) < 0)
+        return 0;
+    return p[0] << 8 | p[1];
+}
+
+uint
+span_u32(struct span *s)
+{
+    const uchar *p = s->data + s->pos;
+
+    if(span_skip(s, 4) < 0)
+        return 0;
+    return (uint)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+uint64
+span_u64(struct span *s)
+{
+    uint64 hi = span_u32(s);
+
+    return hi << 32 | span_u32(s);
+}
+
+void
+span_bytes(struct span *s, void *dst, uint n)
+{
+    const uchar *p = s->data + s->pos;
+
+    if(span_skip(s, n) < 0){
+        memset(dst, 0, n);
+        return;
+    }
+    memmove(dst, p, n);
+}
+
+// Take the next child box out of parent; box->body points into the
+// parent's memory. A size of 1 means a 64-bit largesize follows the
+// type, a size of 0 that the box runs to the end of the parent.
+// Returns 0 at the end or if the size is bad.
+int
+span_box(struct span *parent, struct mp4box *box)
+{
+    memset(box, 0, sizeof(*box));
+    if(span_left(parent) < 8)
+        return 0;
+    box->size = span_u32(parent);
+    span_bytes(parent, box->type, 4);
+    box->hdrsize = 8;
+    if(box->size == 1){
+        box->size = span_u64(parent);
+        box->hdrsize = 16;
+    } else if(box->size == 0){
+        box->size = 8 + span_left(parent);
+    }
+    if(parent->error || box->size < box->hdrsize ||
+       box->size - box->hdrsize > span_left(parent)){
+        fprintf(2, "mp4: bad size %l for box %s\n", box->size, box->type);
+        parent->error = 1;
+        return 0;
+    }
+    box->body.data = parent->data + parent->pos;
+    box->body.size = box->size - box->hdrsize;
+    span_skip(parent, box->body.size);
+    return 1;
+}
+
+int
+box_is(const struct mp4box *box, const char *type)
+{
+    return memcmp(box->type, type, 4) == 0;
+}
+
+// ---------------------------------------------------------------
+// sample index
+
+// The sample tables of one track, each span positioned at its
+// first entry.
+struct stbl {
+    struct span entry;      // first sample entry, after its type
+    struct span stsz, stco, stsc, stts, stss;
+    uint fixed_size;        // stsz sample_size, 0 if per sample
+    uint nsamples;
+    uint nchunks;
+    uint nstsc, nstts, nstss;
+    int co64;               // chunk offsets are 64-bit
+    int have_stss;          // without stss every sample is a sync sample
+};
+
+// Walks the tables one sample at a time.
+struct walker {
+    struct stbl tb;
+    uint sample;            // 0-based, of the next sample
+    uint chunk;             // 1-based, of the current chunk
+    uint left_in_chunk;
+    uint per_chunk;
+    uint next_first_chunk;  // where the next stsc run starts
+    uint next_per_chunk;
+    uint run;               // samples left in the stts run
+    uint delta;
+    uint next_sync;         // 1-based, 0 if none left
+};
+
+struct sampleinfo {
+    uint size;
+    uint dur;
+    int key;
+    int newchunk;
+    uint chunk;             // 0-based
+};
+
+static void
+walker_init(struct walker *w, const struct stbl *tb)
+{
+    memset(w, 0, sizeof(*w));
+    w->tb = *tb;
+    w->next_first_chunk = ~0U;
+    if(w->tb.nstsc > 0){
+        w->next_first_chunk = span_u32(&w->tb.stsc);
+        w->next_per_chunk = span_u32(&w->tb.stsc);
+        span_skip(&w->tb.stsc, 4);
+        w->tb.nstsc--;
+    }
+    if(w->tb.have_stss && w->tb.nstss > 0){
+        w->next_sync = span_u32(&w->tb.stss);
+        w->tb.nstss--;
+    }
+}
+
+static int
+walker_next(struct walker *w, struct sampleinfo *si)
+{
+    si->newchunk = 0;
+    if(w->left_in_chunk == 0){
+        w->chunk++;
+        if(w->chunk == w->next_first_chunk){
+            w->per_chunk = w->next_per_chunk;
+            w->next_first_chunk = ~0U;
+            if(w->tb.nstsc > 0){
+                w->next_first_chunk = span_u32(&w->tb.stsc);
+                w->next_per_chunk = span_u32(&w->tb.stsc);
+                span_skip(&w->tb.stsc, 4);
+                w->tb.nstsc--;
+            }
+        }
+        if(w->per_chunk == 0 || w->chunk > w->tb.nchunks)
+            return -1;
+        w->left_in_chunk = w->per_chunk;
+        si->newchunk = 1;
+    }
+    w->left_in_chunk--;
+    si->chunk = w->chunk - 1;
+
+    si->size = w->tb.fixed_size ? w->tb.fixed_size : span_u32(&w->tb.stsz);
+
+    // past the last stts run the last delta carries on
+    while(w->run == 0 && w->tb.nstts > 0){
+        w->run = span_u32(&w->tb.stts);
+        w->delta = span_u32(&w->tb.stts);
+        w->tb.nstts--;
+    }
+    if(w->run > 0)
+        w->run--;
+    si->dur = w->delta;
+
+    w->sample++;
+    si->key = !w->tb.have_stss;
+    if(w->sample == w->next_sync){
+        si->key = 1;
+        w->next_sync = 0;
+        if(w->tb.nstss > 0){
+            w->next_sync = span_u32(&w->tb.stss);
+            w->tb.nstss--;
+        }
+    }
+    return w->tb.stsz.error || w->tb.stts.error || w->tb.stsc.error ? -1 : 0;
+}
+
+static int
+bitsfor(uint range)
+{
+    int b = 0;
+
+    while(b < 32 && ((uint64)1 << b) <= range)
+        b++;
+    return b;
+}
+
+static void
+putbits(uchar *buf, uint pos, uint v, int n)
+{
+    for(; n > 0; n--, pos++, v >>= 1)
+        if(v & 1)
+            buf[pos >> 3] |= 1 << (pos & 7);
+}
+
+static uint
+getbits(const uchar *buf, uint pos, int n)
+{
+    const uchar *p = buf + (pos >> 3);
+    uint64 v = 0;
+    int i;
+
+    if(n == 0)
+        return 0;
+    // n <= 32 bits starting anywhere in a byte span at most 5 bytes
+    for(i = 0; i < 5 && i * 8 < n + (pos & 7); i++)
+        v |= (uint64)p[i] << (8 * i);
+    return (v >> (pos & 7)) & (((uint64)1 << n) - 1);
+}
+
+// Two passes over the tables: the first sizes every block and
+// fills in its header, the second packs the per-sample deltas.
+static int
+build_index(struct mp4track *t, const struct stbl *tb)
+{
+    struct walker w;
+    struct sampleinfo si[MP4_BLOCK];
+    struct mp4block *b;
+    uint64 off = 0, dts = 0;
+    uint nblocks, i, k, cnt, pos = 0;
+    uint smin, smax, dmin, dmax;
+    int pass;
+
+    t->nsamples = tb->nsamples;
+    t->nchunks = tb->nchunks;
+    nblocks = (t->nsamples + MP4_BLOCK - 1) / MP4_BLOCK;
+    t->chunkoff = malloc(t->nchunks * sizeof(uint64) + 1);
+    t->blocks = malloc(nblocks * sizeof(struct mp4block) + 1);
+    if(t->chunkoff == 0 || t->blocks == 0)
+        return -1;
+    struct span co = tb->stco;
+    for(i = 0; i < t->nchunks; i++)
+        t->chunkoff[i] = tb->co64 ? span_u64(&co) : span_u32(&co);
+    if(co.error)
+        return -1;
+
+    for(pass = 0; pass < 2; pass++){
+        walker_init(&w, tb);
+        for(k = 0; k < nblocks; k++){
+            b = &t->blocks[k];
+            cnt = t->nsamples - k * MP4_BLOCK;
+            if(cnt > MP4_BLOCK)
+                cnt = MP4_BLOCK;
+            for(i = 0; i < cnt; i++)
+                if(walker_next(&w, &si[i]) < 0)
+                    return -1;
+            if(pass == 1){
+                for(i = 0; i < cnt; i++){
+                    putbits(t->bits, b->bitpos + i * (b->size_bits + b->dur_bits),
+                            si[i].size - b->size_base, b->size_bits);
+                    putbits(t->bits, b->bitpos + i * (b->size_bits + b->dur_bits) + b->size_bits,
+                            si[i].dur - b->dur_base, b->dur_bits);
+                }
+                continue;
+            }
+
+            smin = smax = si[0].size;
+            dmin = dmax = si[0].dur;
+            b->keymask = b->chunkmask = 0;
+            for(i = 0; i < cnt; i++){
+                if(si[i].size < smin) smin = si[i].size;
+                if(si[i].size > smax) smax = si[i].size;
+                if(si[i].dur < dmin) dmin = si[i].dur;
+                if(si[i].dur > dmax) dmax = si[i].dur;
+                if(si[i].key)
+                    b->keymask |= 1ULL << i;
+                if(si[i].newchunk)
+                    b->chunkmask |= 1ULL << i;
+                // running offset and dts of each sample
+                if(si[i].newchunk)
+                    off = t->chunkoff[si[i].chunk];
+                if(i == 0){
+                    b->off = off;
+                    b->dts = dts;
+                    b->chunk = si[0].chunk;
+                }
+                off += si[i].size;
+                dts += si[i].dur;
+            }
+            if(smax > t->maxsize)
+                t->maxsize = smax;
+            b->size_base = smin;
+            b->dur_base = dmin;
+            b->size_bits = bitsfor(smax - smin);
+            b->dur_bits = bitsfor(dmax - dmin);
+            b->bitpos = pos;
+            pos += cnt * (b->size_bits + b->dur_bits);
+        }
+        if(pass == 0){
+            if((t->bits = malloc(pos / 8 + 1)) == 0)
+                return -1;
+            memset(t->bits, 0, pos / 8 + 1);
+        }
+    }
+    return 0;
+}
+
+// Bytes taken by n samples of a fixed track. Compressed sound with
+// a version 1 entry counts samples in decoded frames and stores
+// whole packets.
+static uint64
+fixed_bytes(const struct mp4track *t, uint n)
+{
+    if(t->spp > 1 && t->fixed_size == 1)
+        return (uint64)(n / t->spp) * t->bpf;
+    return (uint64)n * t->fixed_size;
+}
+
+// Index a fixed track: where each chunk starts in the file and in
+// samples, from stco and stsc alone.
+static int
+build_fixed(struct mp4track *t, const struct stbl *tb)
+{
+    struct span co = tb->stco, sc = tb->stsc, ts = tb->stts;
+    uint i, n, per = 0, next_first = ~0U, next_per = 0, left = tb->nstsc;
+
+    t->nsamples = tb->nsamples;
+    t->nchunks = tb->nchunks;
+    t->fixed_size = tb->fixed_size;
+    // old QuickTime PCM has a sample size of 1 whatever the format
+    if(t->fixed_size == 1 && t->spp <= 1 && t->channels * t->samplebits >= 16)
+        t->fixed_size = t->bpf ? t->bpf : t->channels * t->samplebits / 8;
+    span_skip(&ts, 4);
+    t->fixed_dur = span_u32(&ts);
+    t->chunkoff = malloc(t->nchunks * sizeof(uint64) + 1);
+    t->chunkfirst = malloc((t->nchunks + 1) * sizeof(uint));
+    if(t->chunkoff == 0 || t->chunkfirst == 0)
+        return -1;
+    if(left > 0){
+        next_first = span_u32(&sc);
+        next_per = span_u32(&sc);
+        span_skip(&sc, 4);
+        left--;
+    }
+    for(i = 0, n = 0; i < t->nchunks; i++){
+        if(i + 1 == next_first){
+            per = next_per;
+            next_first = ~0U;
+            if(left > 0){
+                next_first = span_u32(&sc);
+                next_per = span_u32(&sc);
+                span_skip(&sc, 4);
+                left--;
+            }
+        }
+        t->chunkoff[i] = tb->co64 ? span_u64(&co) : span_u32(&co);
+        t->chunkfirst[i] = n;
+        n = per > t->nsamples - n ? t->nsamples : n + per;
+    }
+    t->chunkfirst[t->nchunks] = n;
+    t->maxsize = fixed_bytes(t, t->spp > 1 ? t->spp : 1);
+    return co.error || sc.error || ts.error || n != t->nsamples ? -1 : 0;
+}
+
+// Look up sample n (0-based) of t. For a fixed track the result
+// covers the run of samples from n to the end of its chunk.
+int
+mp4_sample(const struct mp4track *t, uint n, struct mp4sample *s)
+{
+    const struct mp4block *b;
+    uint i, k, pos, size, dur, chunk, step, lo, hi;
+    uint64 off, dts;
+
+    if(n >= t->nsamples)
+        return -1;
+    if(t->chunkfirst){
+        // the last chunk starting at or before n
+        lo = 0;
+        hi = t->nchunks;
+        while(hi - lo > 1){
+            k = (lo + hi) / 2;
+            if(t->chunkfirst[k] <= n)
+                lo = k;
+            else
+                hi = k;
+        }
+        s->off = t->chunkoff[lo] + fixed_bytes(t, n - t->chunkfirst[lo]);
+        s->count = t->chunkfirst[lo + 1] - n;
+        s->size = fixed_bytes(t, s->count);
+        s->dts = (uint64)n * t->fixed_dur;
+        s->key = 1;
+        return 0;
+    }
+    b = &t->blocks[n / MP4_BLOCK];
+    k = n % MP4_BLOCK;
+    off = b->off;
+    dts = b->dts;
+    chunk = b->chunk;
+    step = b->size_bits + b->dur_bits;
+    for(i = 0, pos = b->bitpos; ; i++, pos += step){
+        size = b->size_base + getbits(t->bits, pos, b->size_bits);
+        if(i == k)
+            break;
+        dur = b->dur_base + getbits(t->bits, pos + b->size_bits, b->dur_bits);
+        dts += dur;
+        if(b->chunkmask & (1ULL << (i + 1))){
+            chunk++;
+            off = t->chunkoff[chunk];
+        } else {
+            off += size;
+        }
+    }
+    s->off = off;
+    s->size = size;
+    s->dts = dts;
+    s->key = (b->keymask >> k) & 1;
+    s->count = 1;
+    return 0;
+}
+
+// The last sample of t at or before dts or, with key set, the last
+// sync sample at or before it. Sample 0 if there is none.
+uint
+mp4_find(const struct mp4track *t, uint64 dts, int key)
+{
+    const struct mp4block *b;
+    uint lo, hi, k, i, pos, step;
+    uint64 mask, d;
+
+    if(t->nsamples == 0)
+        return 0;
+    if(t->chunkfirst){
+        if(t->fixed_dur == 0 || dts / t->fixed_dur >= t->nsamples)
+            return t->nsamples - 1;
+        return dts / t->fixed_dur;
+    }
+    // the last block starting at or before dts
+    lo = 0;
+    hi = (t->nsamples + MP4_BLOCK - 1) / MP4_BLOCK;
+    while(hi - lo > 1){
+        k = (lo + hi) / 2;
+        if(t->blocks[k].dts <= dts)
+            lo = k;
+        else
+            hi = k;
+    }
+    b = &t->blocks[lo];
+    d = b->dts;
+    step = b->size_bits + b->dur_bits;
+    k = t->nsamples - lo * MP4_BLOCK;
+    if(k > MP4_BLOCK)
+        k = MP4_BLOCK;
+    for(i = 0, pos = b->bitpos + b->size_bits; i + 1 < k; i++, pos += step){
+        d += b->dur_base + getbits(t->bits, pos, b->dur_bits);
+        if(d > dts)
+            break;
+    }
+    if(!key)
+        return lo * MP4_BLOCK + i;
+    // back to the nearest set bit of a keymask
+    mask = i == 63 ? ~0ULL : (1ULL << (i + 1)) - 1;
+    for(;;){
+        mask &= t->blocks[lo].keymask;
+        if(mask){
+            for(i = 63; !(mask & (1ULL << i)); i--)
+                ;
+            return lo * MP4_BLOCK + i;
+        }
+        if(lo == 0)
+            return 0;
+        lo--;
+        mask = ~0ULL;
+    }
+}
+
+// Memory held by the index of t.
+uint
+mp4_index_bytes(const struct mp4track *t)
+{
+    uint nblocks = (t->nsamples + MP4_BLOCK - 1) / MP4_BLOCK;
+    const struct mp4block *last;
+    uint bits = 0;
+
+    if(t->chunkfirst)
+        return t->nchunks * (sizeof(uint64) + sizeof(uint)) + sizeof(uint);
+    if(nblocks > 0){
+        last = &t->blocks[nblocks - 1];
+        bits = last->bitpos + (t->nsamples - (nblocks - 1) * MP4_BLOCK) *
+               (last->size_bits + last->dur_bits);
+    }
+    return t->nchunks * sizeof(uint64) + nblocks * sizeof(struct mp4block) + bits / 8 + 1;
+}
+
+// ---------------------------------------------------------------
+// moov walker
+
+// version/flags, then 32- or 64-bit times depending on the version
+static void
+read_times(struct span *s, uint *timescale, uint64 *duration)
+{
+    int version = span_u8(s);
+
+    span_skip(s, 3);
+    if(version == 1){
+        span_skip(s, 16);
+        *timescale = span_u32(s);
+        *duration = span_u64(s);
+    } else {
+        span_skip(s, 8);
+        *timescale = span_u32(s);
+        *duration = span_u32(s);
+    }
+}
+
+static void
+parse_tkhd(struct span *s, struct mp4track *t)
+{
+    int version = span_u8(s);
+
+    span_skip(s, 3);
+    span_skip(s, version == 1 ? 16 : 8);
+    t->id = span_u32(s);
+    span_skip(s, 4);
+    span_skip(s, version == 1 ? 8 : 4);
+    span_skip(s, 8 + 2 + 2 + 2 + 2 + 36);
+    t->width = span_u32(s) >> 16;       // 16.16 fixed point
+    t->height = span_u32(s) >> 16;
+}
+
+static void
+parse_stbl(struct span *s, struct mp4track *t, struct stbl *tb)
+{
+    struct mp4box box;
+
+    while(span_box(s, &box)){
+        struct span *b = &box.body;
+        if(box_is(&box, "stsd")){
+            span_skip(b, 8);            // version/flags, entry_count
+            span_skip(b, 4);            // first entry: size
+            span_bytes(b, t->codec, 4);
+            tb->entry = *b;
+            continue;
+        }
+        span_skip(b, 4);                // version/flags
+        if(box_is(&box, "stsz")){
+            tb->fixed_size = span_u32(b);
+            tb->nsamples = span_u32(b);
+            tb->stsz = *b;
+        } else if(box_is(&box, "stco") || box_is(&box, "co64")){
+            tb->co64 = box_is(&box, "co64");
+            tb->nchunks = span_u32(b);
+            tb->stco = *b;
+        } else if(box_is(&box, "stsc")){
+            tb->nstsc = span_u32(b);
+            tb->stsc = *b;
+        } else if(box_is(&box, "stts")){
+            tb->nstts = span_u32(b);
+            tb->stts = *b;
+        } else if(box_is(&box, "stss")){
+            tb->nstss = span_u32(b);
+            tb->stss = *b;
+            tb->have_stss = 1;
+        }
+    }
+}
+
+// The fields of the first sample entry that the players need; the
+// layout depends on the kind of track.
+static void
+parse_entry(struct span *s, struct mp4track *t)
+{
+    int version;
+
+    if(s->data == 0)
+        return;
+    span_skip(s, 6 + 2);                // reserved, data_reference_index
+    if(memcmp(t->handler, "vide", 4) == 0){
+        span_skip(s, 16);
+        t->width = span_u16(s);
+        t->height = span_u16(s);
+        span_skip(s, 4 + 4 + 4 + 2 + 32);
+        t->depth = span_u16(s);
+    } else if(memcmp(t->handler, "soun", 4) == 0){
+        version = span_u16(s);
+        span_skip(s, 2 + 4);            // revision, vendor
+        t->channels = span_u16(s);
+        t->samplebits = span_u16(s);
+        span_skip(s, 2 + 2);            // compression id, packet size
+        t->samplerate = span_u32(s) >> 16;
+        if(version == 1){
+            t->spp = span_u32(s);
+            span_skip(s, 4);            // bytes per packet, one channel
+            t->bpf = span_u32(s);
+            if(t->bpf == 0)
+                t->spp = 0;
+        }
+    }
+}
+
+// Walk trak down to stbl; containers we do not care about are
+// skipped whole.
+static int
+parse_trak(struct span *s, struct mp4track *t)
+{
+    struct mp4box box, mbox, nbox;
+    struct stbl tb;
+
+    memset(&tb, 0, sizeof(tb));
+    while(span_box(s, &box)){
+        if(box_is(&box, "tkhd")){
+            parse_tkhd(&box.body, t);
+        } else if(box_is(&box, "mdia")){
+            while(span_box(&box.body, &mbox)){
+                if(box_is(&mbox, "mdhd")){
+                    read_times(&mbox.body, &t->timescale, &t->duration);
+                } else if(box_is(&mbox, "hdlr")){
+                    span_skip(&mbox.body, 8);
+                    span_bytes(&mbox.body, t->handler, 4);
+                } else if(box_is(&mbox, "minf")){
+                    while(span_box(&mbox.body, &nbox))
+                        if(box_is(&nbox, "stbl"))
+                            parse_stbl(&nbox.body, t, &tb);
+                }
+            }
+        }
+    }
+    if(tb.nsamples == 0)
+        return 0;
+    if(tb.stco.data == 0 || tb.stsc.data == 0 || tb.stts.data == 0 ||
+       (tb.fixed_size == 0 && tb.stsz.data == 0)){
+        fprintf(2, "mp4: track %d: missing sample tables\n", t->id);
+        return -1;
+    }
+    parse_entry(&tb.entry, t);
+    if(tb.fixed_size && tb.nstts == 1 && !tb.have_stss){
+        if(build_fixed(t, &tb) < 0){
+            fprintf(2, "mp4: track %d: bad chunk tables\n", t->id);
+            return -1;
+        }
+    } else if(build_index(t, &tb) < 0){
+        fprintf(2, "mp4: track %d: bad sample tables\n", t->id);
+        return -1;
+    }
+    return 0;
+}
+
+static int
+readfull(int fd, void *dst, uint n)
+{
+    uint tot;
+    int m;
+
+    for(tot = 0; tot < n; tot += m){
+        if((m = read(fd, (char*)dst + tot, n - tot)) <= 0)
+            return -1;
+    }
+    return 0;
+}
+
+// Read the header of the next top-level box from fd; left is what
+// remains of the file from here, for boxes of size 0. Returns 1 with
+// the header consumed, 0 at the end of the file, -1 if it is bad.
+int
+mp4_header(int fd, uint64 left, struct mp4box *box)
+{
+    uchar hdr[16];
+    struct span s;
+
+    memset(box, 0, sizeof(*box));
+    if(left < 8 || readfull(fd, hdr, 8) < 0)
+        return 0;
+    s.data = hdr;
+    s.size = sizeof(hdr);
+    s.pos = 0;
+    s.error = 0;
+    box->size = span_u32(&s);
+    span_bytes(&s, box->type, 4);
+    box->hdrsize = 8;
+    if(box->size == 1){
+        if(readfull(fd, hdr + 8, 8) < 0)
+            return -1;
+        box->size = span_u64(&s);
+        box->hdrsize = 16;
+    } else if(box->size == 0){
+        box->size = left;
+    }
+    if(box->size < box->hdrsize || box->size > left){
+        fprintf(2, "mp4: bad top-level size %l for box %s\n", box->size, box->type);
+        return -1;
+    }
+    return 1;
+}
+
+// Read the boxes of the file open on fd and index its tracks. Only
+// the top-level headers and moov are read; mdat and the rest are
+// seeked over.
+int
+mp4_open(int fd, struct mp4file *mf)
+{
+    struct stat st;
+    struct span moov;
+    struct mp4box top, box;
+    uint64 pos = 0, len;
+    uchar *buf;
+    int r;
+
+    memset(mf, 0, sizeof(*mf));
+    if(fstat(fd, &st) < 0)
+        return -1;
+    while((r = mp4_header(fd, st.size - pos, &top)) > 0){
+        len = top.size - top.hdrsize;
+        pos += top.size;
+        if(!box_is(&top, "moov")){
+            if(lseek(fd, len, SEEK_CUR) < 0)
+                break;
+            continue;
+        }
+
+        if(len >= 0x80000000 || (buf = malloc(len)) == 0){
+            fprintf(2, "mp4: no memory for a %l byte moov\n", top.size);
+            return -1;
+        }
+        if(readfull(fd, buf, len) < 0){
+            fprintf(2, "mp4: short moov\n");
+            free(buf);
+            return -1;
+        }
+        moov.data = buf;
+        moov.size = len;
+        moov.pos = 0;
+        moov.error = 0;
+        while(span_box(&moov, &box)){
+            if(box_is(&box, "mvhd")){
+                read_times(&box.body, &mf->movie_timescale, &mf->movie_duration);
+            } else if(box_is(&box, "trak") && mf->ntrack < MP4_MAXTRACK){
+                memset(&mf->track[mf->ntrack], 0, sizeof(struct mp4track));
+                if(parse_trak(&box.body, &mf->track[mf->ntrack]) < 0){
+                    free(buf);
+                    mp4_close(mf);
+                    return -1;
+                }
+                if(mf->track[mf->ntrack].nsamples > 0)
+                    mf->ntrack++;
+            }
+        }
+        free(buf);
+        return 0;
+    }
+    if(r == 0)
+        fprintf(2, "mp4: no moov box\n");
+    return -1;
+}
+
+void
+mp4_close(struct mp4file *mf)
+{
+    int i;
+
+    for(i = 0; i < MP4_MAXTRACK; i++){
+        struct mp4track *t = &mf->track[i];
+        if(t->chunkoff)
+            free(t->chunkoff);
+        if(t->blocks)
+            free(t->blocks);
+        if(t->bits)
+            free(t->bits);
+        if(t->chunkfirst)
+            free(t->chunkfirst);
+        t->chunkoff = 0;
+        t->blocks = 0;
+        t->bits = 0;
+        t->chunkfirst = 0;
+    }
+    mf->ntrack = 0;
+}
+
+// ---------------------------------------------------------------
+// interleaved reading
+
+void
+mp4_demux_init(struct mp4demux *d, struct mp4file *mf)
+{
+    int i;
+
+    memset(d, 0, sizeof(*d));
+    d->mf = mf;
+    for(i = 0; i < mf->ntrack; i++)
+        d->use[i] = 1;
+}
+
+// The next sample of the chosen tracks in decode order, its track
+// in s->track. Returns the track, or -1 when all are done.
+int
+mp4_demux_next(struct mp4demux *d, struct mp4sample *s)
+{
+    struct mp4track *t;
+    struct mp4sample cand;
+    uint64 key, best = ~0ULL;
+    uint maxlead = 0, n;
+    int i, pick = -1;
+
+    for(i = 0; i < d->mf->ntrack; i++)
+        if(d->use[i] && d->lead[i] > maxlead)
+            maxlead = d->lead[i];
+    for(i = 0; i < d->mf->ntrack; i++){
+        t = &d->mf->track[i];
+        if(!d->use[i] || mp4_sample(t, d->next[i], &cand) < 0 || t->timescale == 0)
+            continue;
+        key = cand.dts * 1000 / t->timescale + maxlead - d->lead[i];
+        if(key < best){
+            best = key;
+            pick = i;
+            *s = cand;
+        }
+    }
+    if(pick < 0)
+        return -1;
+
+    t = &d->mf->track[pick];
+    if(t->chunkfirst){
+        // one sample or packet, or as much of the run as fits in a
+        // unit, in whole packets
+        if(t->spp > 1 && t->fixed_size == 1)
+            n = (d->unit[pick] / t->bpf > 1 ? d->unit[pick] / t->bpf : 1) * t->spp;
+        else
+            n = d->unit[pick] / t->fixed_size > 1 ? d->unit[pick] / t->fixed_size : 1;
+        if(n < s->count)
+            s->count = n;
+        s->size = fixed_bytes(t, s->count);
+    }
+    d->next[pick] += s->count;
+    s->track = pick;
+    return pick;
+}
+
+// Move the chosen tracks to ms into the movie. Each track has to
+// start from a sync sample, so all of them go back to the earliest
+// sync sample at or before ms. Returns the time reached, in ms.
+uint
+mp4_demux_seek(struct mp4demux *d, uint ms)
+{
+    struct mp4track *t;
+    struct mp4sample s;
+    uint64 at = ms, tms[MP4_MAXTRACK];
+    int i;
+
+    for(i = 0; i < d->mf->ntrack; i++){
+        t = &d->mf->track[i];
+        if(!d->use[i] || t->timescale == 0 || t->nsamples == 0)
+            continue;
+        d->next[i] = mp4_find(t, (uint64)ms * t->timescale / 1000, 1);
+        mp4_sample(t, d->next[i], &s);
+        tms[i] = s.dts * 1000 / t->timescale;
+        if(tms[i] < at)
+            at = tms[i];
+    }
+    for(i = 0; i < d->mf->ntrack; i++){
+        t = &d->mf->track[i];
+        if(d->use[i] && t->timescale != 0 && t->nsamples != 0 && tms[i] > at)
+            d->next[i] = mp4_find(t, at * t->timescale / 1000, 1);
+    }
+    return at;
+}
+
+// Read the bytes of s into buf, which holds at least s->size.
+int
+mp4_read(int fd, const struct mp4sample *s, void *buf)
+{
+    if(lseek(fd, s->off, SEEK_SET) < 0)
+        return -1;
+    return readfull(fd, buf, s->size);
+}
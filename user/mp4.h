@@ -0,0 +1,122 @@
+#ifndef _MP4_H_
+#define _MP4_H_
+
+// ISO base media (MP4) demuxing: a bounds-checked box walker, a
+// compact per-track sample index and an interleaving reader.
+
+// A span is a cursor over bytes already in memory. Reads past the
+// end return 0 and set error rather than leaving the buffer.
+struct span {
+    const uchar *data;
+    uint size;
+    uint pos;
+    int error;
+};
+
+struct mp4box {
+    uint64 size;            // header included
+    uint hdrsize;           // 8, or 16 with a 64-bit largesize
+    char type[5];
+    struct span body;       // payload, points into the parent
+};
+
+uint span_left(const struct span *s);
+int span_skip(struct span *s, uint n);
+uint span_u8(struct span *s);
+uint span_u16(struct span *s);
+uint span_u32(struct span *s);
+uint64 span_u64(struct span *s);
+void span_bytes(struct span *s, void *dst, uint n);
+int span_box(struct span *parent, struct mp4box *box);
+int box_is(const struct mp4box *box, const char *type);
+int mp4_header(int fd, uint64 left, struct mp4box *box);
+
+// The index keeps one mp4block per MP4_BLOCK samples. Within a block
+// sample sizes and durations are stored as bit-packed deltas from
+// the block minimum, so a lookup walks at most MP4_BLOCK-1 entries.
+#define MP4_BLOCK    64
+#define MP4_MAXTRACK 4
+
+struct mp4block {
+    uint64 dts;             // of the first sample
+    uint64 off;             // file offset of the first sample
+    uint64 keymask;         // bit i: sample i is a sync sample
+    uint64 chunkmask;       // bit i: sample i starts a new chunk
+    uint chunk;             // chunk of the first sample
+    uint bitpos;            // of the first sample in mp4track.bits
+    uint size_base;
+    uint dur_base;
+    uchar size_bits;
+    uchar dur_bits;
+};
+
+struct mp4track {
+    uint id;
+    char handler[5];        // "vide", "soun", ...
+    char codec[5];          // first sample entry in stsd: "avc1", "mp4a", "jpeg" ...
+    uint timescale;
+    uint64 duration;        // in timescale units
+    uint width, height;     // from tkhd, video only
+    uint depth;             // video sample entry: bits per pixel
+    uint channels;          // sound sample entry
+    uint samplebits;
+    uint samplerate;
+    uint spp, bpf;          // sound, version 1: samples per packet,
+                            // bytes per packet of all channels
+
+    uint nsamples;
+    uint nchunks;
+    uint maxsize;           // of the largest sample
+    uint64 *chunkoff;
+    struct mp4block *blocks;
+    uchar *bits;
+
+    // Tracks with one sample size, one duration and no sync table
+    // (PCM audio, raw video) are not indexed per sample: a sample is
+    // found from the first sample of its chunk.
+    uint fixed_size;
+    uint fixed_dur;
+    uint *chunkfirst;       // nchunks+1 entries
+};
+
+struct mp4file {
+    int ntrack;
+    struct mp4track track[MP4_MAXTRACK];
+    uint movie_timescale;
+    uint64 movie_duration;
+};
+
+struct mp4sample {
+    uint64 off;             // file offset
+    uint size;
+    uint64 dts;             // in track timescale units
+    int key;                // sync sample
+    uint count;             // samples covered: for a fixed track, the
+                            // rest of the chunk, otherwise 1
+    int track;              // set by mp4_demux_next
+};
+
+int mp4_open(int fd, struct mp4file *mf);
+int mp4_sample(const struct mp4track *t, uint n, struct mp4sample *s);
+uint mp4_find(const struct mp4track *t, uint64 dts, int key);
+uint mp4_index_bytes(const struct mp4track *t);
+void mp4_close(struct mp4file *mf);
+
+// Reads the chosen tracks of a file in decode order, each track at
+// its own cursor. A track with a lead runs that many ms ahead of the
+// others; runs of a fixed track with a unit size are merged into
+// reads of up to that many bytes.
+struct mp4demux {
+    struct mp4file *mf;
+    int use[MP4_MAXTRACK];
+    uint next[MP4_MAXTRACK];    // next sample of each track
+    uint lead[MP4_MAXTRACK];    // ms
+    uint unit[MP4_MAXTRACK];    // bytes, 0 for one sample at a time
+};
+
+void mp4_demux_init(struct mp4demux *d, struct mp4file *mf);
+int mp4_demux_next(struct mp4demux *d, struct mp4sample *s);
+uint mp4_demux_seek(struct mp4demux *d, uint ms);
+int mp4_read(int fd, const struct mp4sample *s, void *buf);
+
+#endif // _MP4_H_
@@ -6,6 +6,8 @@
 #include "kernel/stat.h"
 #include "user/user.h"
 #include "kernel/fs.h"
+#include "kernel/fcntl.h"
+#include "user/mp4.h"
 
 #define NULL 0
 #define PRINTF_DEBUG
@@ -29,6 +31,7 @@
 #define BOX_TYPE_STSC "stsc"
 #define BOX_TYPE_STSZ "stsz"
 #define BOX_TYPE_STCO "stco"
+#define BOX_TYPE_CO64 "co64"
 #define BOX_TYPE_UDTA "udta"
 #define MAX_BOX_SIZE_LEN 4
 #define MAX_BOX_TYPE_LEN 4
@@ -44,12 +47,6 @@
 #define MAX_PRE_DEFINE_LEN 24
 #define MAX_MATRIX_LEN 36
 #define MAX_HDLR_NAME_LEN 100
-typedef struct t_box_header
-{
-    int boxSize;
-    unsigned char boxType[MAX_BOX_TYPE_LEN+1];
-    long largeBoxSize; /* if boxSize=1 use, if boxSize=0, end of file */
-} T_BOX_HEADER;
 /********************************************************************************************
  55 **                            File Type Box (ftyp): file type, 表明文件类型
  56 **
@@ -422,37 +419,32 @@ typedef struct t_box4stsz
 447 ************************************************************************************************************/
 typedef struct t_box4stco_entry
 {
-    int chunk_offset;
+    uint64 chunk_offset;
 } T_BOX4STCO_ENTRY;
 typedef struct t_box4stco
 {
     int entry_count;
     T_BOX4STCO_ENTRY entrys[MAX_STCO_ENTRY_NUM];
 } T_BOX4STCO;
-typedef struct t_box
-{
-    T_BOX_HEADER boxHeader;
-    unsigned char *boxData;
-} T_BOX;
-static void DealBox4ftyp(const T_BOX *box)
+typedef struct mp4box T_BOX;
+static void DealBox4ftyp(struct span *s)
 {
     int i = 0;
-    int j = 0;
     int brandsNum = 0;
     T_BOX4FTYP box4ftyp = {0};
     memset(&box4ftyp, 0x0, sizeof(T_BOX4FTYP));
-    memcpy(box4ftyp.major_brand, box->boxData, 4);
+    span_bytes(s, box4ftyp.major_brand, 4);
     box4ftyp.major_brand[MAX_FTYP_BRABDS_LEN] = '\0';
-    box4ftyp.minor_version =  box->boxData[4] << 24 | box->boxData[5] << 16 | box->boxData[6] << 8 | box->boxData[7];
-    brandsNum = (box->boxHeader.boxSize - MAX_BOX_SIZE_LEN - MAX_BOX_TYPE_LEN - MAX_FTYP_BRABDS_LEN - 4) / 4;
-    /* 1. if not have '', 每个brands的内存是连续的, 导致打印时后面的每4个数据都会加到前面;
-485        2. unsigned char brands[MAX_FTYP_BRABDS_LEN+1]; 可解决, 此时也不必加'', 但需初始化;
-486        3. 因此字符串最好定义+1并赋'';
-487        4. 复现: unsigned char brands[MAX_FTYP_BRABDS_LEN]
-488     */
+    box4ftyp.minor_version = span_u32(s);
+    brandsNum = span_left(s) / 4;
+    if (brandsNum > MAX_FTYP_BRABDS_NUM)
+    {
+        brandsNum = MAX_FTYP_BRABDS_NUM;
+    }
+    /* 字符串定义+1并赋'\0', 否则打印时后面的brands会连在一起 */
     for (i=0; i<brandsNum; i++)
     {
-        memcpy(box4ftyp.compatible_brands[i].brands, box->boxData+MAX_FTYP_BRABDS_LEN+4+4*i, 4);
+        span_bytes(s, box4ftyp.compatible_brands[i].brands, 4);
         box4ftyp.compatible_brands[i].brands[MAX_FTYP_BRABDS_LEN] = '\0';
     }
 #ifdef PRINTF_DEBUG
@@ -471,128 +463,82 @@ static void DealBox4ftyp(const T_BOX *box)
     printf("\n");
 #endif
 }
-static void DealBox4mvhd(const unsigned char *mvhdData)
+static void DealBox4mvhd(struct span *s)
 {
-    unsigned char *data = NULL;
     T_BOX4MVHD box4mvhd = {0};
     memset(&box4mvhd, 0x0, sizeof(T_BOX4MVHD));
-    data = (unsigned char *)mvhdData;
-    data += 4;
-    box4mvhd.creation_time = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    box4mvhd.modification_time = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    box4mvhd.timescale = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    box4mvhd.duration = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    //box4mvhd.rate = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    box4mvhd.rate = (data[0] << 8 | data[1]) + (data[2] << 8 | data[3]);
-    data += 4;
-    //box4mvhd.volume = data[0] << 8 | data[1];
-    box4mvhd.volume = data[0] + data[1];
-    data += 2;
-    data += (MAX_MVHD_RESERVED_LEN + MAX_PRE_DEFINE_LEN + MAX_MATRIX_LEN);
-    box4mvhd.next_track_id = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
+    span_skip(s, 4);
+    box4mvhd.creation_time = span_u32(s);
+    box4mvhd.modification_time = span_u32(s);
+    box4mvhd.timescale = span_u32(s);
+    box4mvhd.duration = span_u32(s);
+    box4mvhd.rate = span_u16(s);
+    box4mvhd.rate += span_u16(s);
+    box4mvhd.volume = span_u8(s);
+    box4mvhd.volume += span_u8(s);
+    span_skip(s, MAX_MVHD_RESERVED_LEN + MAX_PRE_DEFINE_LEN + MAX_MATRIX_LEN);
+    box4mvhd.next_track_id = span_u32(s);
 #ifdef PRINTF_DEBUG
     printf("ttcreation_time: %d, modification_time: %d, timescale: %d, duration: %d, rate: %f, volume: %f, next_track_id: %d\n",
            box4mvhd.creation_time, box4mvhd.modification_time, box4mvhd.timescale, box4mvhd.duration, box4mvhd.rate, box4mvhd.volume, box4mvhd.next_track_id);
 #endif
 }
-static void DealBox4tkhd(const unsigned char *tkhdData)
+static void DealBox4tkhd(struct span *s)
 {
-    unsigned char *data = NULL;
     T_BOX4TKHD box4tkhd = {0};
     memset(&box4tkhd, 0x0, sizeof(box4tkhd));
-    data = (unsigned char *)tkhdData;
-    box4tkhd.flags = data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    box4tkhd.creation_time = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    box4tkhd.modification_time = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    box4tkhd.track_id = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    data += 4; /* 4 reserved */
-    box4tkhd.duration = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    data += 8; /* 8 reserved */
-    box4tkhd.layer = data[0] << 8 | data[1];
-    data += 2;
-    box4tkhd.alternate_group = data[0] << 8 | data[1];
-    data += 2;
-    box4tkhd.volume = data[0] + data[1];
-    data += 2;
-    data += 2;
-    data += 36;
-    box4tkhd.width = (data[0] << 8 | data[1]) + (data[2] << 8 | data[3]);
-    data += 4;
-    box4tkhd.height = (data[0] << 8 | data[1]) + (data[2] << 8 | data[3]);
+    box4tkhd.flags = span_u32(s) & 0xffffff;
+    box4tkhd.creation_time = span_u32(s);
+    box4tkhd.modification_time = span_u32(s);
+    box4tkhd.track_id = span_u32(s);
+    span_skip(s, 4); /* 4 reserved */
+    box4tkhd.duration = span_u32(s);
+    span_skip(s, 8); /* 8 reserved */
+    box4tkhd.layer = span_u16(s);
+    box4tkhd.alternate_group = span_u16(s);
+    box4tkhd.volume = span_u8(s);
+    box4tkhd.volume += span_u8(s);
+    span_skip(s, 2 + MAX_MATRIX_LEN);
+    box4tkhd.width = span_u16(s);
+    box4tkhd.width += span_u16(s);
+    box4tkhd.height = span_u16(s);
+    box4tkhd.height += span_u16(s);
 #ifdef PRINTF_DEBUG
     printf("tttflags: %d, creation_time: %d, modification_time: %d, track_id: %d, duration: %d, layer: %d, alternate_group: %d, volume: %f, width: %f, height: %f\n",
            box4tkhd.flags, box4tkhd.creation_time, box4tkhd.modification_time, box4tkhd.track_id, box4tkhd.duration, box4tkhd.layer, box4tkhd.alternate_group, box4tkhd.volume, box4tkhd.width, box4tkhd.height);
 #endif
 }
-static void DealBox4dref(const T_BOX *box)
+static void DealBox4dref(struct span *s)
 {
     // TODO
 }
-static void DealBox4dinf(const T_BOX *box)
-{    int boxSize = 0;
-    int dinfDataSize = 0;
-    unsigned char *dinfData = NULL;
-    unsigned char *data = NULL;
-    char boxType[MAX_BOX_TYPE_LEN+1] = {0};
-    T_BOX drefBox = {0};
-    dinfData = box->boxData;
-    dinfDataSize = box->boxHeader.boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN;
-    while (dinfDataSize > 0)
+static void DealBox4dinf(struct span *s)
+{
+    T_BOX child;
+    while (span_box(s, &child))
     {
-        boxSize = dinfData[0] << 24 | dinfData[1] << 16 | dinfData[2] << 8 | dinfData[3];
-        memcpy(boxType, dinfData+MAX_BOX_SIZE_LEN, 4);
 #ifdef PRINTF_DEBUG
         printf("ttttt****BOX: Layer6****\n");
-        printf("ttttttsize: %d\n", boxSize);
-        printf("tttttttype: %s\n", boxType);
+        printf("ttttttsize: %l\n", child.size);
+        printf("tttttttype: %s\n", child.type);
 #endif
-        if (0 == strcmp(boxType, BOX_TYPE_DREF))
+        if (box_is(&child, BOX_TYPE_DREF))
         {
-            memset(&drefBox, 0x0, sizeof(T_BOX));
-            drefBox.boxHeader.boxSize = boxSize;
-            memcpy(drefBox.boxHeader.boxType, boxType, strlen(boxType));
-            drefBox.boxData = (unsigned char*)malloc(boxSize);
-            if (drefBox.boxData)
-            {
-                memcpy(drefBox.boxData, dinfData+MAX_BOX_SIZE_LEN+MAX_BOX_TYPE_LEN, boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN);
-                DealBox4dref((const T_BOX*)&drefBox);
-                free(drefBox.boxData);
-                drefBox.boxData = NULL;
-            }
+            DealBox4dref(&child.body);
         }
-        dinfData += boxSize;
-        dinfDataSize -= boxSize;
     }
 }
-static void DealBox4stts(const unsigned char *sttsData)
+static void DealBox4stts(struct span *s)
 {
     int i = 0;
-    unsigned char *data = NULL;
     T_BOX4STTS box4stts = {0};
     memset(&box4stts, 0x0, sizeof(box4stts));
-    data = (unsigned char *)sttsData;
-    data += 4;
-    box4stts.entry_count = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    for (i=0; i<box4stts.entry_count; i++)
+    span_skip(s, 4);
+    box4stts.entry_count = span_u32(s);
+    for (i=0; i<box4stts.entry_count && i<MAX_STTS_ENTRY_NUM; i++)
     {
-        if (i == MAX_STTS_ENTRY_NUM)
-        {
-            break;
-        }
-        box4stts.entrys[i].sample_count = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-        data += 4;
-        box4stts.entrys[i].sample_delta = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-        data += 4;
+        box4stts.entrys[i].sample_count = span_u32(s);
+        box4stts.entrys[i].sample_delta = span_u32(s);
     }
 #ifdef PRINTF_DEBUG
     printf("tttentry_count: %d, [sample_count, sample_delta]: ", box4stts.entry_count);
@@ -615,24 +561,16 @@ static void DealBox4stts(const unsigned char *sttsData)
     printf("\n");
 #endif
 }
-static void DealBox4stss(const unsigned char *stssData)
+static void DealBox4stss(struct span *s)
 {
     int i = 0;
-    unsigned char *data = NULL;
     T_BOX4STSS box4stss = {0};
     memset(&box4stss, 0x0, sizeof(box4stss));
-    data = (unsigned char *)stssData;
-    data += 4;
-    box4stss.entry_count = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    for (i=0; i<box4stss.entry_count; i++)
+    span_skip(s, 4);
+    box4stss.entry_count = span_u32(s);
+    for (i=0; i<box4stss.entry_count && i<MAX_STSS_ENTRY_NUM; i++)
     {
-        if (i == MAX_STSS_ENTRY_NUM)
-        {
-            break;
-        }
-        box4stss.entrys[i].sample_num = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-        data += 4;
+        box4stss.entrys[i].sample_num = span_u32(s);
     }
 #ifdef PRINTF_DEBUG
     printf("tttentry_count: %d, sample_num: ", box4stss.entry_count);
@@ -655,28 +593,18 @@ static void DealBox4stss(const unsigned char *stssData)
     printf("\n");
 #endif
 }
-static void DealBox4stsc(const unsigned char *stscData)
+static void DealBox4stsc(struct span *s)
 {
     int i = 0;
-    unsigned char *data = NULL;
     T_BOX4STSC box4stsc = {0};
     memset(&box4stsc, 0x0, sizeof(box4stsc));
-    data = (unsigned char *)stscData;
-    data += 4;
-    box4stsc.entry_count = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    for (i=0; i<box4stsc.entry_count; i++)
+    span_skip(s, 4);
+    box4stsc.entry_count = span_u32(s);
+    for (i=0; i<box4stsc.entry_count && i<MAX_STSC_ENTRY_NUM; i++)
     {
-        if (i == MAX_STSC_ENTRY_NUM)
-        {
-            break;
-        }
-        box4stsc.entrys[i].first_chunk = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-        data += 4;
-        box4stsc.entrys[i].samples_per_chunk = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-        data += 4;
-        box4stsc.entrys[i].sample_description_index = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-        data += 4;
+        box4stsc.entrys[i].first_chunk = span_u32(s);
+        box4stsc.entrys[i].samples_per_chunk = span_u32(s);
+        box4stsc.entrys[i].sample_description_index = span_u32(s);
     }
 #ifdef PRINTF_DEBUG
     printf("tttentry_count: %d, [first_chunk, samples_per_chunk, sample_description_index]: ", box4stsc.entry_count);
@@ -699,26 +627,17 @@ static void DealBox4stsc(const unsigned char *stscData)
     printf("\n");
 #endif
 }
-static void DealBox4stsz(const unsigned char *stszData)
+static void DealBox4stsz(struct span *s)
 {
     int i = 0;
-    unsigned char *data = NULL;
     T_BOX4STSZ box4stsz = {0};
     memset(&box4stsz, 0x0, sizeof(box4stsz));
-    data = (unsigned char *)stszData;
-    data += 4;
-    box4stsz.sample_size = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    box4stsz.sample_count = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    for (i=0; i<box4stsz.sample_count; i++)
+    span_skip(s, 4);
+    box4stsz.sample_size = span_u32(s);
+    box4stsz.sample_count = span_u32(s);
+    for (i=0; i<box4stsz.sample_count && i<MAX_STSZ_ENTRY_NUM; i++)
     {
-        if (i == MAX_STSZ_ENTRY_NUM)
-        {
-            break;
-        }
-        box4stsz.entrys[i].entry_size = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-        data += 4;
+        box4stsz.entrys[i].entry_size = span_u32(s);
     }
 #ifdef PRINTF_DEBUG
     printf("tttsample_size: %d, sample_count: %d, [entry_size]: ", box4stsz.sample_size, box4stsz.sample_count);
@@ -741,24 +660,17 @@ static void DealBox4stsz(const unsigned char *stszData)
     printf("\n");
 #endif
 }
-static void DealBox4stco(const unsigned char *stcoData)
+/* co64 has the same layout with 64-bit offsets */
+static void DealBox4stco(struct span *s, int is64)
 {
     int i = 0;
-    unsigned char *data = NULL;
     T_BOX4STCO box4stco = {0};
     memset(&box4stco, 0x0, sizeof(box4stco));
-    data = (unsigned char *)stcoData;
-    data += 4;
-    box4stco.entry_count = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    for (i=0; i<box4stco.entry_count; i++)
+    span_skip(s, 4);
+    box4stco.entry_count = span_u32(s);
+    for (i=0; i<box4stco.entry_count && i<MAX_STCO_ENTRY_NUM; i++)
     {
-        if (i == MAX_STCO_ENTRY_NUM)
-        {
-            break;
-        }
-        box4stco.entrys[i].chunk_offset = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-        data += 4;
+        box4stco.entrys[i].chunk_offset = is64 ? span_u64(s) : span_u32(s);
     }
 #ifdef PRINTF_DEBUG
     printf("ttentry_count: %d, [chunk_offset]: ", box4stco.entry_count);
@@ -772,7 +684,7 @@ static void DealBox4stco(const unsigned char *stcoData)
         {
             printf(", ");
         }
-        printf("[%d]", box4stco.entrys[i].chunk_offset);
+        printf("[%l]", box4stco.entrys[i].chunk_offset);
     }
     if (box4stco.entry_count==MAX_STCO_ENTRY_NUM)
     {
@@ -781,408 +693,273 @@ static void DealBox4stco(const unsigned char *stcoData)
     printf("\n");
 #endif
 }
-static void DealBox4stbl(const T_BOX *box)
+static void DealBox4stbl(struct span *s)
 {
-    int boxSize = 0;
-    int stblDataSize = 0;
-    unsigned char *stblData = NULL;
-    unsigned char *data = NULL;
-    char boxType[MAX_BOX_TYPE_LEN+1] = {0};
-    stblData = box->boxData;
-    stblDataSize = box->boxHeader.boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN;
-    while (stblDataSize > 0)
+    T_BOX child;
+    while (span_box(s, &child))
     {
-        boxSize = stblData[0] << 24 | stblData[1] << 16 | stblData[2] << 8 | stblData[3];
-        memcpy(boxType, stblData+MAX_BOX_SIZE_LEN, 4);
 #ifdef PRINTF_DEBUG
         printf("ttttt****BOX: Layer6****\n");
-        printf("ttttttsize: %d\n", boxSize);
-        printf("tttttttype: %s\n", boxType);
+        printf("ttttttsize: %l\n", child.size);
+        printf("tttttttype: %s\n", child.type);
 #endif
-        if (0 == strcmp(boxType, BOX_TYPE_STTS))
+        if (box_is(&child, BOX_TYPE_STTS))
         {
-            data = (unsigned char*)malloc(boxSize);
-            if (data)
-            {
-                memcpy(data, stblData+MAX_BOX_SIZE_LEN+MAX_BOX_TYPE_LEN, boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN);
-                DealBox4stts(data);
-                free(data);
-                data = NULL;
-            }
+            DealBox4stts(&child.body);
         }
-        else if (0 == strcmp(boxType, BOX_TYPE_STSS))
+        else if (box_is(&child, BOX_TYPE_STSS))
         {
-            data = (unsigned char*)malloc(boxSize);
-            if (data)
-            {
-                memcpy(data, stblData+MAX_BOX_SIZE_LEN+MAX_BOX_TYPE_LEN, boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN);
-                DealBox4stss(data);
-                free(data);
-                data = NULL;
-            }
+            DealBox4stss(&child.body);
         }
-        else if (0 == strcmp(boxType, BOX_TYPE_STSC))
+        else if (box_is(&child, BOX_TYPE_STSC))
         {
-            data = (unsigned char*)malloc(boxSize);
-            if (data)
-            {
-                memcpy(data, stblData+MAX_BOX_SIZE_LEN+MAX_BOX_TYPE_LEN, boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN);
-                DealBox4stsc(data);
-                free(data);
-                data = NULL;
-            }
+            DealBox4stsc(&child.body);
         }
-        else if (0 == strcmp(boxType, BOX_TYPE_STSZ))
+        else if (box_is(&child, BOX_TYPE_STSZ))
         {
-            data = (unsigned char*)malloc(boxSize);
-            if (data)
-            {
-                memcpy(data, stblData+MAX_BOX_SIZE_LEN+MAX_BOX_TYPE_LEN, boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN);
-                DealBox4stsz(data);
-                free(data);
-                data = NULL;
-            }
+            DealBox4stsz(&child.body);
         }
-        else if (0 == strcmp(boxType, BOX_TYPE_STCO))
+        else if (box_is(&child, BOX_TYPE_STCO) || box_is(&child, BOX_TYPE_CO64))
         {
-            data = (unsigned char*)malloc(boxSize);
-            if (data)
-            {
-                memcpy(data, stblData+MAX_BOX_SIZE_LEN+MAX_BOX_TYPE_LEN, boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN);
-                DealBox4stco(data);
-                free(data);
-                data = NULL;
-            }
+            DealBox4stco(&child.body, box_is(&child, BOX_TYPE_CO64));
         }
-        stblData += boxSize;
-        stblDataSize -= boxSize;
     }
 }
-static void DealBox4mdhd(const unsigned char *mdhdData)
+static void DealBox4mdhd(struct span *s)
 {
-    unsigned char *data = NULL;
     T_BOX4MDHD box4mdhd = {0};
     memset(&box4mdhd, 0x0, sizeof(box4mdhd));
-    data = (unsigned char *)mdhdData;
-    data += 4;
-    box4mdhd.creation_time = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    box4mdhd.modification_time = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    box4mdhd.timescale = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    box4mdhd.duration = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-    data += 4;
-    box4mdhd.language = data[0] << 8 | data[1];
+    span_skip(s, 4);
+    box4mdhd.creation_time = span_u32(s);
+    box4mdhd.modification_time = span_u32(s);
+    box4mdhd.timescale = span_u32(s);
+    box4mdhd.duration = span_u32(s);
+    box4mdhd.language = span_u16(s);
 #ifdef PRINTF_DEBUG
-    //printf("tttcreation_time: %d, modification_time: %d, timescale: %d, duration: %d, language: %c%c%cn",
-    //box4mdhd.creation_time, box4mdhd.modification_time, box4mdhd.timescale, box4mdhd.duration, (box4mdhd.language>>10&0x1f), (box4mdhd.language>>5&0x1f), (box4mdhd.language&0x1f));
     printf("ttttcreation_time: %d, modification_time: %d, timescale: %d, duration: %d, language:%d\n",
            box4mdhd.creation_time, box4mdhd.modification_time, box4mdhd.timescale, box4mdhd.duration, box4mdhd.language);
 #endif
 }
-static void DealBox4hdlr(const unsigned char *hdlrData)
+static void DealBox4hdlr(struct span *s)
 {
     int i = 0;
-    unsigned char *data = NULL;
     T_BOX4HDLR box4hdlr = {0};
     memset(&box4hdlr, 0x0, sizeof(box4hdlr));
-    data = (unsigned char *)hdlrData;
-    data += 4;
-    data += 4;
-    memcpy(box4hdlr.handler_type, data, 4);
+    span_skip(s, 8);
+    span_bytes(s, box4hdlr.handler_type, 4);
     box4hdlr.handler_type[MAX_HANDLER_TYPE_LEN] = '\0';
-    data += 4;
-    data += 12;
-    while ('\0' != data[i])
+    span_skip(s, 12);
+    while (i < MAX_HDLR_NAME_LEN && span_left(s) > 0 && '\0' != (box4hdlr.name[i] = span_u8(s)))
     {
         i++;
     }
-    memcpy(box4hdlr.name, data, i);
-    box4hdlr.name[MAX_HDLR_NAME_LEN] = '\0';
+    box4hdlr.name[i] = '\0';
 #ifdef PRINTF_DEBUG
     printf("tttthandler_type: %s, name: %s\n", box4hdlr.handler_type, box4hdlr.name);
 #endif
 }
-static void DealBox4vmdhd(const unsigned char *vmdhdData)
+static void DealBox4vmdhd(struct span *s)
 {
     // TODO
 }
-static void DealBox4minf(const T_BOX *box)
-{    int boxSize = 0;
-    int minfDataSize = 0;
-    unsigned char *minfData = NULL;
-    unsigned char *data = NULL;
-    char boxType[MAX_BOX_TYPE_LEN+1] = {0};
-    T_BOX dinfBox = {0};
-    T_BOX stblBox = {0};
-    minfData = box->boxData;
-    minfDataSize = box->boxHeader.boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN;
-    while (minfDataSize > 0)
+static void DealBox4minf(struct span *s)
+{
+    T_BOX child;
+    while (span_box(s, &child))
     {
-        boxSize = minfData[0] << 24 | minfData[1] << 16 | minfData[2] << 8 | minfData[3];
-        memcpy(boxType, minfData+MAX_BOX_SIZE_LEN, 4);
 #ifdef PRINTF_DEBUG
         printf("tttt********BOX: Layer5********\n");
-        printf("tttttsize: %d\n", boxSize);
-        printf("ttttttype: %s\n", boxType);
+        printf("tttttsize: %l\n", child.size);
+        printf("ttttttype: %s\n", child.type);
 #endif
-        if (0 == strcmp(boxType, BOX_TYPE_VMHD))
+        if (box_is(&child, BOX_TYPE_VMHD))
         {
-            data = (unsigned char*)malloc(boxSize);
-            if (data)
-            {
-                memcpy(data, minfData+MAX_BOX_SIZE_LEN+MAX_BOX_TYPE_LEN, boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN);
-                DealBox4vmdhd(data);
-                free(data);
-                data = NULL;
-            }
+            DealBox4vmdhd(&child.body);
         }
-        else if (0 == strcmp(boxType, BOX_TYPE_DINF))
+        else if (box_is(&child, BOX_TYPE_DINF))
         {
-            memset(&dinfBox, 0x0, sizeof(T_BOX));
-            dinfBox.boxHeader.boxSize = boxSize;
-            memcpy(dinfBox.boxHeader.boxType, boxType, strlen(boxType));
-            dinfBox.boxData = (unsigned char*)malloc(boxSize);
-            if (dinfBox.boxData)
-            {
-                memcpy(dinfBox.boxData, minfData+MAX_BOX_SIZE_LEN+MAX_BOX_TYPE_LEN, boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN);
-                DealBox4dinf((const T_BOX*)&dinfBox);
-                free(dinfBox.boxData);
-                dinfBox.boxData = NULL;
-            }
+            DealBox4dinf(&child.body);
         }
-        else if (0 == strcmp(boxType, BOX_TYPE_STBL))
+        else if (box_is(&child, BOX_TYPE_STBL))
         {
-            memset(&stblBox, 0x0, sizeof(T_BOX));
-            stblBox.boxHeader.boxSize = boxSize;
-            memcpy(stblBox.boxHeader.boxType, boxType, strlen(boxType));
-            stblBox.boxData = (unsigned char*)malloc(boxSize);
-            if (stblBox.boxData)
-            {
-                memcpy(stblBox.boxData, minfData+MAX_BOX_SIZE_LEN+MAX_BOX_TYPE_LEN, boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN);
-                DealBox4stbl((const T_BOX*)&stblBox);
-                free(stblBox.boxData);
-                stblBox.boxData = NULL;
-            }
+            DealBox4stbl(&child.body);
         }
-        minfData += boxSize;
-        minfDataSize -= boxSize;
     }
 }
-static void DealBox4mdia(const T_BOX *box)
-{    int boxSize = 0;
-    int mdiaDataSize = 0;
-    unsigned char *mdiaData = NULL;
-    unsigned char *data = NULL;
-    char boxType[MAX_BOX_TYPE_LEN+1] = {0};
-    T_BOX minfBox = {0};
-    mdiaData = box->boxData;
-    mdiaDataSize = box->boxHeader.boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN;
-    while (mdiaDataSize > 0)
+static void DealBox4mdia(struct span *s)
+{
+    T_BOX child;
+    while (span_box(s, &child))
     {
-        boxSize = mdiaData[0] << 24 | mdiaData[1] << 16 | mdiaData[2] << 8 | mdiaData[3];
-        memcpy(boxType, mdiaData+MAX_BOX_SIZE_LEN, 4);
 #ifdef PRINTF_DEBUG
         printf("ttt************BOX: Layer4************\n");
-        printf("ttttsize: %d\n", boxSize);
-        printf("tttttype: %s\n", boxType);
+        printf("ttttsize: %l\n", child.size);
+        printf("tttttype: %s\n", child.type);
 #endif
-        if (0 == strcmp(boxType, BOX_TYPE_MDHD))
+        if (box_is(&child, BOX_TYPE_MDHD))
         {
-            data = (unsigned char*)malloc(boxSize);
-            if (data)
-            {
-                memcpy(data, mdiaData+MAX_BOX_SIZE_LEN+MAX_BOX_TYPE_LEN, boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN);
-                DealBox4mdhd(data);
-                free(data);
-                data = NULL;
-            }
+            DealBox4mdhd(&child.body);
         }
-        else if (0 == strcmp(boxType, BOX_TYPE_HDLR))
+        else if (box_is(&child, BOX_TYPE_HDLR))
         {
-            data = (unsigned char*)malloc(boxSize);
-            if (data)
-            {
-                memcpy(data, mdiaData+MAX_BOX_SIZE_LEN+MAX_BOX_TYPE_LEN, boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN);
-                DealBox4hdlr(data);
-                free(data);
-                data = NULL;
-            }
+            DealBox4hdlr(&child.body);
         }
-        else if (0 == strcmp(boxType, BOX_TYPE_MINF))
+        else if (box_is(&child, BOX_TYPE_MINF))
         {
-            memset(&minfBox, 0x0, sizeof(T_BOX));
-            minfBox.boxHeader.boxSize = boxSize;
-            memcpy(minfBox.boxHeader.boxType, boxType, strlen(boxType));
-            minfBox.boxData = (unsigned char*)malloc(boxSize);
-            if (minfBox.boxData)
-            {
-                memcpy(minfBox.boxData, mdiaData+MAX_BOX_SIZE_LEN+MAX_BOX_TYPE_LEN, boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN);
-                DealBox4minf((const T_BOX*)&minfBox);
-                free(minfBox.boxData);
-                minfBox.boxData = NULL;
-            }
+            DealBox4minf(&child.body);
         }
-        mdiaData += boxSize;
-        mdiaDataSize -= boxSize;
     }
 }
-static void DealBox4trak(const T_BOX *box)
+static void DealBox4trak(struct span *s)
 {
-    int boxSize = 0;
-    int trakDataSize = 0;
-    unsigned char *trakData = NULL;
-    unsigned char *data = NULL;
-    char boxType[MAX_BOX_TYPE_LEN+1] = {0};
-    T_BOX mdiaBox = {0};
-    trakData = box->boxData;
-    trakDataSize = box->boxHeader.boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN;
-    while (trakDataSize > 0)
+    T_BOX child;
+    while (span_box(s, &child))
     {
-        boxSize = trakData[0] << 24 | trakData[1] << 16 | trakData[2] << 8 | trakData[3];
-        memcpy(boxType, trakData+MAX_BOX_SIZE_LEN, 4);
 #ifdef PRINTF_DEBUG
         printf("tt****************BOX: Layer3****************\n");
-        printf("tttsize: %d\n", boxSize);
-        printf("ttttype: %s\n", boxType);
+        printf("tttsize: %l\n", child.size);
+        printf("ttttype: %s\n", child.type);
 #endif
-        if (0 == strcmp(boxType, BOX_TYPE_TKHD))
+        if (box_is(&child, BOX_TYPE_TKHD))
         {
-            data = (unsigned char*)malloc(boxSize);
-            if (data)
-            {
-                memcpy(data, trakData+MAX_BOX_SIZE_LEN+MAX_BOX_TYPE_LEN, boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN);
-                DealBox4tkhd(data);
-                free(data);
-                data = NULL;
-            }
+            DealBox4tkhd(&child.body);
         }
-        else if (0 == strcmp(boxType, BOX_TYPE_MDIA))
+        else if (box_is(&child, BOX_TYPE_MDIA))
         {
-            memset(&mdiaBox, 0x0, sizeof(T_BOX));
-            mdiaBox.boxHeader.boxSize = boxSize;
-            memcpy(mdiaBox.boxHeader.boxType, boxType, strlen(boxType));
-            mdiaBox.boxData = (unsigned char*)malloc(boxSize);
-            if (mdiaBox.boxData)
-            {
-                memcpy(mdiaBox.boxData, trakData+MAX_BOX_SIZE_LEN+MAX_BOX_TYPE_LEN, boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN);
-                DealBox4mdia((const T_BOX*)&mdiaBox);
-                free(mdiaBox.boxData);
-                mdiaBox.boxData = NULL;
-            }
+            DealBox4mdia(&child.body);
         }
-        trakData += boxSize;
-        trakDataSize -= boxSize;
     }
 }
-static void DealBox4moov(const T_BOX *box)
+static void DealBox4moov(struct span *s)
 {
-    printf("hello\n");
-    int boxSize = 0;
-    int moovDataSize = 0;
-    unsigned char *moovData = NULL;
-    unsigned char *data = NULL;
-    char boxType[MAX_BOX_TYPE_LEN+1] = {0};
-    T_BOX trakBox = {0};
-    moovData = box->boxData;
-    moovDataSize = box->boxHeader.boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN;
-    while (moovDataSize > 0)
+    T_BOX child;
+    while (span_box(s, &child))
     {
-        boxSize = moovData[0] << 24 | moovData[1] << 16 | moovData[2] << 8 | moovData[3];
-        memcpy(boxType, moovData+MAX_BOX_SIZE_LEN, 4);
-        boxType[MAX_BOX_TYPE_LEN] = '\0';
 #ifdef PRINTF_DEBUG
         printf("t********************BOX: Layer2********************\n");
-        printf("ttsize: %d\n", boxSize);
-        printf("tttype: %s\n", boxType);
+        printf("ttsize: %l\n", child.size);
+        printf("tttype: %s\n", child.type);
 #endif
-        if (0 == strcmp(boxType, BOX_TYPE_MVHD))
+        if (box_is(&child, BOX_TYPE_MVHD))
         {
-            data = (unsigned char*)malloc(boxSize);
-            if (data)
-            {
-                memcpy(data, moovData+MAX_BOX_SIZE_LEN+MAX_BOX_TYPE_LEN, boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN);
-                DealBox4mvhd(data);
-                free(data);
-                data = NULL;
-            }
+            DealBox4mvhd(&child.body);
         }
-        else if (0 == strcmp(boxType, BOX_TYPE_TRAK))
+        else if (box_is(&child, BOX_TYPE_TRAK))
         {
-            memset(&trakBox, 0x0, sizeof(T_BOX));
-            trakBox.boxHeader.boxSize = boxSize;
-            memcpy(trakBox.boxHeader.boxType, boxType, strlen(boxType));
-            trakBox.boxData = (unsigned char*)malloc(boxSize);
-            if (trakBox.boxData)
-            {
-                memcpy(trakBox.boxData, moovData+MAX_BOX_SIZE_LEN+MAX_BOX_TYPE_LEN, boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN);
-                DealBox4trak((const T_BOX*)&trakBox);
-                free(trakBox.boxData);
-                trakBox.boxData = NULL;
-            }
+            DealBox4trak(&child.body);
         }
-        moovData += boxSize;
-        moovDataSize -= boxSize;
     }
 }
-static void DealBox(const T_BOX *box)
+static void DealBox(T_BOX *box)
 {
 #ifdef PRINTF_DEBUG
     printf("****************************BOX: Layer1****************************\n");
-    printf("tsize: %d\n", box->boxHeader.boxSize);
-    printf("ttype: %s\n", box->boxHeader.boxType);
+    printf("tsize: %l\n", box->size);
+    printf("ttype: %s\n", box->type);
 #endif
-    char tmptype[10] = "";
-    for(int i = 0; i < 4; ++i)
-        tmptype[i] = box->boxHeader.boxType[i];
-    if (0 == strcmp(tmptype, BOX_TYPE_FTYPE))
+    if (box_is(box, BOX_TYPE_FTYPE))
+    {
+        DealBox4ftyp(&box->body);
+    }
+    else if (box_is(box, BOX_TYPE_MOOV))
     {
-        DealBox4ftyp(box);
+        DealBox4moov(&box->body);
     }
-    else if (0 == strcmp(tmptype, BOX_TYPE_MOOV))
+}
+static uint64 bytesRead = 0;
+static int ReadFull(int fd, unsigned char *buf, int n)
+{
+    int tot = 0;
+    int m = 0;
+    for (tot = 0; tot < n; tot += m)
     {
-        DealBox4moov(box);
+        if ((m = read(fd, buf + tot, n - tot)) <= 0)
+        {
+            return -1;
+        }
+        bytesRead += m;
     }
+    return 0;
 }
 int main(int argc, char *argv[])
 {
-    unsigned char boxSize[MAX_BOX_SIZE_LEN] = {0};
+    unsigned char *payload = NULL;
     T_BOX box = {0};
+    struct stat st;
+    uint64 pos = 0;
+    uint64 size = 0;
     if (2 != argc)
     {
         printf("Usage: mp4parse **.mp4\n");
         return -1;
     }
     int fd = open(argv[1], 0);
-    if (fd < 0)
+    if (fd < 0 || fstat(fd, &st) < 0)
     {
         printf("open file[%s] error!\n", argv[1]);
         return -1;
     }
-    while (1)
+    /* Only the box headers, ftyp and moov are read; everything else
+       (mdat above all) is seeked over. Headers may
+       carry a 64-bit largesize, or size 0 for a box that runs to the
+       end of the file. */
+    while (mp4_header(fd, st.size-pos, &box) > 0)
     {
-        memset(&box, 0x0, sizeof(T_BOX));
-        if (read(fd, boxSize, 1 * 4) <= 0)
+        box.type[MAX_BOX_TYPE_LEN] = '\0';
+        size = box.size-box.hdrsize;
+        pos += box.size;
+        if (!box_is(&box, BOX_TYPE_FTYPE) && !box_is(&box, BOX_TYPE_MOOV))
         {
-            break;
+#ifdef PRINTF_DEBUG
+            printf("****************************BOX: Layer1****************************\n");
+            printf("tsize: %l\n", box.size);
+            printf("ttype: %s\n", box.type);
+#endif
+            if (lseek(fd, size, SEEK_CUR) < 0)
+            {
+                break;
+            }
+            continue;
         }
-        box.boxHeader.boxSize = boxSize[0] << 24 | boxSize[1] << 16 | boxSize[2] << 8 | boxSize[3];
-        read(fd, box.boxHeader.boxType, 1 * 4);
-        box.boxHeader.boxType[MAX_BOX_TYPE_LEN] = '\0';
-        box.boxData = (unsigned char*)malloc(box.boxHeader.boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN);
-        if (!box.boxData)
+        payload = size < 0x80000000 ? (unsigned char*)malloc(size) : NULL;
+        if (!payload)
         {
             printf("malloc data error!\n");
             break;
         }
-        read(fd, box.boxData, 1 * box.boxHeader.boxSize-MAX_BOX_SIZE_LEN-MAX_BOX_TYPE_LEN);
+        if (ReadFull(fd, payload, size) < 0)
+        {
+            printf("short read in %s box\n", box.type);
+            free(payload);
+            break;
+        }
+        box.body.data = payload;
+        box.body.size = size;
         /* deal box data */
         DealBox(&box);
-        /* free box */
-        free(box.boxData);
-        box.boxData = NULL;
+        free(payload);
+        payload = NULL;
+    }
+    printf("read %l of %l bytes\n", bytesRead, st.size);
+    /* the sample index built by mp4.c from the complete tables */
+    struct mp4file mf;
+    struct mp4sample last;
+    if (lseek(fd, 0, SEEK_SET) == 0 && mp4_open(fd, &mf) == 0)
+    {
+        for (int i = 0; i < mf.ntrack; i++)
+        {
+            struct mp4track *t = &mf.track[i];
+            int keys = 0;
+            for (uint n = 0; n < t->nsamples; n++)
+            {
+                mp4_sample(t, n, &last);
+                keys += last.key;
+            }
+            printf("track %d (%s, %s): %d samples, %d sync, %d chunks, last sample at %d size %d, index %d bytes\n",
+                   t->id, t->handler, t->codec, t->nsamples, keys, t->nchunks, (int)last.off, last.size, mp4_index_bytes(t));
+        }
+        mp4_close(&mf);
     }
     close(fd);
     return 0;
-}
\ No newline at end of file
+}
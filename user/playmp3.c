@@ -0,0 +1,103 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+#include "user/decode.h"
+#include "user/audio.h"
+
+// playmp3 file.mp3      decode and play through the AC97 card
+// playmp3 -b file.mp3   decode only and report the speed as a
+//                       multiple of realtime (run with CPUS=1 to
+//                       measure a single hart)
+// playmp3 -d ...        use the double precision filterbank rather
+//                       than the fixed-point one
+
+#define TICKS_PER_SEC   10      // timer interval in kernel/start.c
+
+static Bit_stream_struc bs;
+static struct frame_params fr_ps;
+static int playing;
+
+// pcm_sink for playback. The sample rate is only known once the
+// first frame header has been read, so the card is set up on the
+// first call.
+static void
+play(const short *pcm, int nbytes)
+{
+    if(!playing){
+        if(audio_open(s_freq[fr_ps.header->sampling_frequency]) < 0){
+            printf("playmp3: sound card busy\n");
+            exit(0);
+        }
+        playing = 1;
+    }
+    audio_write(pcm, nbytes);
+}
+
+static void
+bench(void)
+{
+    uint64 samples = 0, x100;
+    int frames = 0, n, t0, ticks, rate;
+
+    pcm_sink = 0;
+    t0 = uptime();
+    while((n = mp3_decode_frame(&bs, &fr_ps)) > 0){
+        samples += n;
+        frames++;
+    }
+    ticks = uptime() - t0;
+    if(frames == 0){
+        printf("playmp3: no frames\n");
+        return;
+    }
+    rate = s_freq[fr_ps.header->sampling_frequency];
+    if(ticks == 0)
+        ticks = 1;
+    // (audio seconds / wall seconds) * 100
+    x100 = samples * 100 * TICKS_PER_SEC / ((uint64)rate * ticks);
+    printf("%d frames, %d.%d s of audio in %d ticks: %d.%d%dx realtime\n",
+           frames, (int)(samples / rate), (int)(samples * 10 / rate % 10), ticks,
+           (int)(x100 / 100), (int)(x100 / 10 % 10), (int)(x100 % 10));
+}
+
+int
+main(int argc, char *argv[])
+{
+    int fd, benchmark = 0;
+
+    while(argc > 1 && argv[1][0] == '-'){
+        if(strcmp(argv[1], "-b") == 0)
+            benchmark = 1;
+        else if(strcmp(argv[1], "-d") == 0)
+            mp3_use_double = 1;
+        else
+            break;
+        argv++;
+        argc--;
+    }
+    if(argc < 2){
+        printf("usage: playmp3 [-b] [-d] file.mp3\n");
+        exit(0);
+    }
+    if((fd = open(argv[1], O_RDONLY)) < 0){
+        printf("open mp3 file fail\n");
+        exit(0);
+    }
+    open_bit_stream_r(&bs, fd);
+
+    if(benchmark){
+        bench();
+    } else {
+        pcm_sink = play;
+        while(mp3_decode_frame(&bs, &fr_ps) > 0)
+            ;
+        if(playing)
+            audio_close();
+        else
+            printf("playmp3: no MPEG-1 Layer III frames in %s\n", argv[1]);
+    }
+
+    close(fd);
+    exit(0);
+}
@@ -4,33 +4,40 @@
 #include "kernel/fcntl.h"
 #include "user/user.h"
 #include "user/font.h"
+#include "kernel/sound.h"
+#include "user/mp4.h"
+#include "user/wav.h"
+#include "user/audio.h"
+#include "user/nanojpeg.h"
+#include "user/rgb.h"
 
-struct RGB_Header {
-    uint16 type;
-    uint8 compression;      // 0 = uncompressed, 1 = RLE compressed
-    uint8 bytesPerPixel;    // 1 = 8 bit, 2 = 16 bit
-    uint16 dimension;
-    uint16 width;
-    uint16 height;
-    uint16 channels;
-    uint32 minPixelValue;
-    uint32 maxPixelValue;
-    uint32 reserved;
-    char name[80];
-    uint32 colorMapID;
-    char dummy[404];
-}header;
+// playmp4 file.mp4      play the raw or Motion-JPEG video and the
+//                       PCM/IMA ADPCM sound tracks of an MP4/QuickTime
+//                       file
+// playmp4 -b file.mp4   decode the video only, as fast as possible,
+//                       and report the frame rate
+// playmp4 file.rgb      play a raw RGB565 stream, or one compressed by
+//                       mkfs/rgbenc, and file.wav beside it
+
+struct RGB_Header header;
 
 #define WINDOW_WIDTH 320
 #define WINDOW_HEIGHT 200
 #define max(x, y) (((x) > (y)) ? (x) : (y))
 #define min(x, y) (((x) < (y)) ? (x) : (y))
 
-int update;
+// Keys, after ctrl+z as in viewer: A/D jump SEEK_STEP seconds back
+// or forward, 1/2/4 play at that speed. Above 1x there is no sound
+// and late frames are skipped without being read.
+#define SEEK_BACK       'a'
+#define SEEK_FORWARD    'd'
+#define SEEK_STEP       10      // s
+
 int fd;
-int n;
 uint16 buf[WINDOW_HEIGHT * WINDOW_WIDTH];
 char fbuf[WINDOW_HEIGHT][WINDOW_WIDTH];
+static volatile int seekreq;    // s to move by, from key_handle
+static volatile int speed = 1;
 
 void loadVideo(char name[]) {
     fd = open(name, O_RDONLY);
@@ -40,61 +47,658 @@ void loadVideo(char name[]) {
     }
 }
 
-void draw() {
-    if((n = read(fd, buf, sizeof(buf))) > 0) {
-        for(int i = 0; i < WINDOW_HEIGHT; ++i)
-            for(int j = 0; j < WINDOW_WIDTH; ++j) {
-                int pos = i * WINDOW_WIDTH + j;
-                uint16 val = buf[pos];
-                // format rrrr rggg gggb bbbb
-                int r = (int)((val & 0xF800) >> (6 + 5 + 3));
-                int g = (int)((val & 0x07E0) >> (5 + 3));
-                int b = (int)((val & 0x001E) >> (2));
-                fbuf[i][j] = (char)((r << 6) | (g << 3) | b);
+// Runs on the key callback, in the middle of whatever the player
+// was doing: it only leaves requests for the playback loop.
+void key_handle(uint64 key0, uint64 key1) {
+    if(key1 == SEEK_BACK)
+        seekreq -= SEEK_STEP;
+    else if(key1 == SEEK_FORWARD)
+        seekreq += SEEK_STEP;
+    else if(key1 == '1' || key1 == '2' || key1 == '4')
+        speed = key1 - '0';
+    cb_return();
+}
+
+// Playing an MP4 directly: the demuxer hands over the video and
+// sound samples in decode order, each read from the file only when
+// it is due. Sound runs AUDIO_LEAD ms ahead of the video so that
+// the ring never runs dry while a frame waits for its time; the
+// ring itself bounds how far ahead that can get.
+#define AUDIO_LEAD      250     // ms
+#define TICKS_PER_SEC   10      // timer interval in kernel/start.c
+
+static struct mp4file mf;
+static struct mp4demux dm;
+static struct wavinfo pcm;      // layout of a PCM sound track
+static short out[AUDIO_SLOT_SIZE / 2];
+
+// The clock maps movie time to uptime ticks. It is set again on
+// every seek and change of speed, so only the time since then runs
+// at the new speed.
+static int clock_tick, clock_speed;
+static uint clock_ms;
+
+static void
+clock_set(uint ms)
+{
+    clock_tick = uptime();
+    clock_ms = ms;
+    clock_speed = speed;
+}
+
+static int
+clock_due(uint ms)
+{
+    return clock_tick + ((int)ms - (int)clock_ms) * TICKS_PER_SEC / (1000 * clock_speed);
+}
+
+// Seek latency runs from taking a request to showing the first
+// frame at the new place.
+static int seek_start = -1, nseek, seek_ticks;
+
+static int
+seek_take(void)
+{
+    int ms = seekreq * 1000;
+
+    seekreq = 0;
+    seek_start = uptime();
+    return ms;
+}
+
+static void
+seek_done(void)
+{
+    if(seek_start >= 0){
+        seek_ticks += uptime() - seek_start;
+        nseek++;
+        seek_start = -1;
+    }
+}
+
+static void
+seek_report(void)
+{
+    if(nseek > 0)
+        printf("playmp4: %d seeks, %d ms to the first frame on average\n",
+               nseek, seek_ticks * 1000 / TICKS_PER_SEC / nseek);
+}
+
+static int xmap[WINDOW_WIDTH], ymap[WINDOW_HEIGHT];
+static int outw, outh;          // of the picture in the window
+static int picw, pich;          // of the picture the maps are for
+
+static int
+is_jpeg(const struct mp4track *t)
+{
+    return memcmp(t->codec, "jpeg", 4) == 0 || memcmp(t->codec, "mjpa", 4) == 0;
+}
+
+static int
+video_codec(const struct mp4track *t)
+{
+    if(t->width == 0 || t->height == 0)
+        return 0;
+    if(is_jpeg(t))
+        return 1;
+    return memcmp(t->codec, "raw ", 4) == 0 &&
+           (t->depth == 16 || t->depth == 24 || t->depth == 32);
+}
+
+static int
+sound_codec(const struct mp4track *t)
+{
+    if(t->channels != 1 && t->channels != 2)
+        return 0;
+    if(memcmp(t->codec, "ima4", 4) == 0)
+        return 1;
+    if(memcmp(t->codec, "sowt", 4) == 0 || memcmp(t->codec, "twos", 4) == 0)
+        return t->samplebits == 16;
+    if(memcmp(t->codec, "raw ", 4) == 0)
+        return t->samplebits == 8;      // unsigned
+    return 0;
+}
+
+// Fit a w x h picture into the window keeping its aspect ratio.
+static void
+fit(int w, int h)
+{
+    outw = WINDOW_WIDTH;
+    outh = h * WINDOW_WIDTH / w;
+    if(outh > WINDOW_HEIGHT){
+        outh = WINDOW_HEIGHT;
+        outw = w * WINDOW_HEIGHT / h;
+    }
+    picw = pich = 0;
+    memset(fbuf, 0, sizeof(fbuf));
+}
+
+// The JPEG decoder can hand out the picture at 1/2, 1/4 or 1/8 of
+// its size for little more than the cost of the smaller picture.
+// Take the smallest one that still has a pixel for every pixel of
+// the window.
+static int
+jpeg_scale(const struct mp4track *t)
+{
+    int s = 0;
+
+    while(s < 3 && (t->width >> (s + 1)) >= outw && (t->height >> (s + 1)) >= outh)
+        s++;
+    return s;
+}
+
+// Scale a w x h picture into fbuf; each window pixel takes the
+// nearest picture pixel. bpp 1 is grayscale, 2 big-endian RGB555,
+// 3 RGB and 4 ARGB.
+static void
+blit(const uchar *p, int w, int h, int stride, int bpp)
+{
+    int x0 = (WINDOW_WIDTH - outw) / 2, y0 = (WINDOW_HEIGHT - outh) / 2;
+    int x, y, r, g, b, v;
+    const uchar *q;
+
+    // An interlaced mjpa sample decodes to its first field only,
+    // at half the height: the maps stretch it back.
+    if(w != picw || h != pich){
+        for(x = 0; x < outw; x++)
+            xmap[x] = x * w / outw;
+        for(y = 0; y < outh; y++)
+            ymap[y] = y * h / outh;
+        picw = w;
+        pich = h;
+    }
+    for(y = 0; y < outh; y++){
+        for(x = 0; x < outw; x++){
+            q = p + ymap[y] * stride + xmap[x] * bpp;
+            if(bpp == 1){
+                r = g = b = q[0];
+            } else if(bpp == 2){
+                v = q[0] << 8 | q[1];
+                r = (v >> 7) & 0xf8;
+                g = (v >> 2) & 0xf8;
+                b = (v << 3) & 0xf8;
+            } else {
+                q += bpp - 3;
+                r = q[0];
+                g = q[1];
+                b = q[2];
             }
-    } else {
-        exit(0);
+            // format: rrgggbbb
+            fbuf[y0 + y][x0 + x] = (r >> 6) << 6 | (g >> 5) << 3 | b >> 5;
+        }
     }
 }
 
-void key_handle(uint64 key0, uint64 key1) {
-    int step = 10;
+// Decode one video sample into fbuf. Uncompressed QuickTime rows
+// may be padded, so their stride comes from the frame size.
+static int
+decode_video(const uchar *p, uint size, const struct mp4track *t)
+{
+    int bpp, stride;
 
-    update = 1;
-    cb_return();
+    if(is_jpeg(t)){
+        if(njDecode(p, size) != NJ_OK)
+            return -1;
+        bpp = njIsColor() ? 3 : 1;
+        blit(njGetImage(), njGetWidth(), njGetHeight(), njGetWidth() * bpp, bpp);
+        return 0;
+    }
+    bpp = t->depth / 8;
+    stride = size / t->height;
+    if(stride < t->width * bpp)
+        return -1;
+    blit(p, t->width, t->height, stride, bpp);
+    return 0;
 }
 
-int main(int argc, char *argv[]) {
-    if(argc < 2){
-        printf("Usage: playmp4 *.rgb\n");
+static void
+play_sound(uchar *p, uint size, const struct mp4track *t)
+{
+    int ch = t->channels, i, n, frames;
+
+    if(memcmp(t->codec, "ima4", 4) == 0){
+        for(; size >= IMA4_PACKET * ch; size -= IMA4_PACKET * ch, p += IMA4_PACKET * ch)
+            audio_write(out, ima4_decode(p, ch, out));
+        return;
+    }
+    if(memcmp(t->codec, "twos", 4) == 0){
+        for(i = 0; i + 1 < size; i += 2){
+            uchar c = p[i];
+            p[i] = p[i + 1];
+            p[i + 1] = c;
+        }
+    }
+    for(frames = size / pcm.block_align; frames > 0; frames -= n){
+        n = frames < AUDIO_SLOT_SIZE / WAV_OUT_FRAME ? frames : AUDIO_SLOT_SIZE / WAV_OUT_FRAME;
+        audio_write(out, wavconvert(p, n, &pcm, out));
+        p += n * pcm.block_align;
+    }
+}
+
+// Decode rates are measured in ticks spent in decode_video, so
+// that with -b they leave out the reads and in playback the sleeps.
+static void
+report(int shown, int dropped, int bad, int ticks, uint64 bytes)
+{
+    int fps10;
+
+    printf("playmp4: %d frames shown, %d dropped, %d bad, %d KB of video read\n",
+           shown, dropped, bad, (int)(bytes / 1024));
+    if(ticks == 0)
+        ticks = 1;
+    fps10 = shown * TICKS_PER_SEC * 10 / ticks;
+    printf("playmp4: decoded in %d ticks, %d.%d fps\n", ticks, fps10 / 10, fps10 % 10);
+}
+
+static void
+play_mp4(char *name, int benchmark)
+{
+    struct mp4track *t;
+    struct mp4sample s;
+    uchar *buf;
+    uint bufsize = AUDIO_SLOT_SIZE;
+    uint64 vbytes = 0;
+    int i, k, v = -1, a = -1, ms, pos = 0, due, t0, ticks = 0;
+    int shown = 0, dropped = 0, bad = 0;
+
+    fd = open(name, O_RDONLY);
+    if(fd < 0){
+        printf("playmp4: cannot open %s\n", name);
+        exit(1);
+    }
+    if(mp4_open(fd, &mf) < 0)
+        exit(1);
+    for(i = 0; i < mf.ntrack; i++){
+        t = &mf.track[i];
+        if(v < 0 && memcmp(t->handler, "vide", 4) == 0 && video_codec(t))
+            v = i;
+        else if(a < 0 && memcmp(t->handler, "soun", 4) == 0 && sound_codec(t))
+            a = i;
+        else
+            printf("playmp4: skipping track %d (%s, %s)\n", t->id, t->handler, t->codec);
+    }
+    if(benchmark)
+        a = -1;
+    else if(a >= 0 && audio_open(mf.track[a].samplerate) < 0){
+        printf("playmp4: sound card busy\n");
+        a = -1;
+    }
+    if(v < 0 && a < 0){
+        printf("playmp4: nothing to play in %s\n", name);
         exit(1);
     }
-    loadVideo(argv[1]);
 
-    int len = strlen(argv[1]);
-    argv[1][len - 3] = 'w';
-    argv[1][len - 2] = 'a';
-    argv[1][len - 1] = 'v';
+    mp4_demux_init(&dm, &mf);
+    for(i = 0; i < mf.ntrack; i++)
+        dm.use[i] = i == v || i == a;
+    if(a >= 0){
+        t = &mf.track[a];
+        dm.lead[a] = AUDIO_LEAD;
+        dm.unit[a] = AUDIO_SLOT_SIZE;
+        pcm.format = WAV_FORMAT_PCM;
+        pcm.channel = t->channels;
+        pcm.bits_per_sample = t->samplebits;
+        pcm.block_align = t->channels * t->samplebits / 8;
+        if(t->maxsize > bufsize)
+            bufsize = t->maxsize;
+    }
+    if(v >= 0){
+        t = &mf.track[v];
+        fit(t->width, t->height);
+        if(is_jpeg(t)){
+            njInit();
+            njSetScale(jpeg_scale(t));
+        }
+        if(t->maxsize > bufsize)
+            bufsize = t->maxsize;
+    }
+    if((buf = malloc(bufsize)) == 0){
+        printf("playmp4: no memory for %d byte samples\n", bufsize);
+        exit(1);
+    }
 
-    int pid = fork();
-    if(pid == 0) {
-        sleep(8);
-        exec("playwav", argv);
-        exit(0);
+    if(v >= 0 && !benchmark)
+        reg_keycb(key_handle);
+    clock_set(0);
+    while((k = mp4_demux_next(&dm, &s)) >= 0){
+        t = &mf.track[k];
+        if(seekreq){
+            // s is from before the seek and goes unread
+            ms = pos + seek_take();
+            clock_set(mp4_demux_seek(&dm, ms < 0 ? 0 : ms));
+            continue;
+        }
+        ms = s.dts * 1000 / t->timescale;
+        if(k == v && !benchmark){
+            if(speed != clock_speed)
+                clock_set(ms);
+            // a late frame is dropped before it costs any I/O
+            due = clock_due(ms);
+            if(uptime() > due + 1){
+                dropped++;
+                continue;
+            }
+            if(uptime() < due)
+                sleep(due - uptime());
+            pos = ms;
+        } else if(k == a && clock_speed != 1){
+            continue;
+        }
+        if(s.size > bufsize || mp4_read(fd, &s, buf) < 0){
+            printf("playmp4: cannot read sample at %d\n", (int)s.off);
+            break;
+        }
+        if(k == v){
+            vbytes += s.size;
+            t0 = uptime();
+            if(decode_video(buf, s.size, t) < 0){
+                bad++;
+                continue;
+            }
+            ticks += uptime() - t0;
+            shown++;
+            if(!benchmark){
+                show_window((char *) fbuf);
+                seek_done();
+            }
+        } else {
+            play_sound(buf, s.size, t);
+        }
+    }
+    if(a >= 0)
+        audio_close();
+    if(v >= 0){
+        if(!benchmark)
+            close_window();
+        report(shown, dropped, bad, ticks, vbytes);
+        seek_report();
+        if(is_jpeg(&mf.track[v]))
+            njDone();
     }
+    free(buf);
+    mp4_close(&mf);
+    close(fd);
+}
+
+// Where playback can start. A plain stream seeks by arithmetic; a
+// compressed one only at a key frame, so rgb_index() reads the frame
+// headers once and keeps where every key frame starts.
+struct rgbkey {
+    uint frame;
+    uint off;
+};
+
+static struct rgbkey *keys;
+static int nkeys, nframes;
+static uint dataoff;            // of frame 0
+static uint frametime;          // us
+
+static int
+rgb_index(void)
+{
+    struct rgbframe f;
+    struct rgbkey *k;
+    uint off = dataoff;
+    int cap = 0;
+
+    for(nframes = 0; lseek(fd, off, SEEK_SET) >= 0 && read(fd, &f, sizeof(f)) == sizeof(f); nframes++){
+        if(f.flags & RGB_KEY){
+            if(nkeys == cap){
+                cap = cap ? 2 * cap : 64;
+                if((k = malloc(cap * sizeof(*k))) == 0)
+                    return -1;
+                if(keys){
+                    memmove(k, keys, nkeys * sizeof(*k));
+                    free(keys);
+                }
+                keys = k;
+            }
+            keys[nkeys].frame = nframes;
+            keys[nkeys].off = off;
+            nkeys++;
+        }
+        off += sizeof(f) + f.size;
+    }
+    return lseek(fd, dataoff, SEEK_SET);
+}
+
+// The last key frame at or before frame n, -1 if there is none.
+static int
+rgb_key(int n)
+{
+    int lo = 0, hi = nkeys, m;
+
+    if(nkeys == 0 || keys[0].frame > n)
+        return -1;
+    while(hi - lo > 1){
+        m = (lo + hi) / 2;
+        if(keys[m].frame <= n)
+            lo = m;
+        else
+            hi = m;
+    }
+    return lo;
+}
+
+static uint
+frame_ms(int n)
+{
+    return (uint64)n * frametime / 1000;
+}
+
+// Go to frame n or, in a compressed stream, the key frame before it.
+// Returns the frame reached, -1 if the file cannot go there.
+static int
+rgb_seek(int n)
+{
+    int k;
+
+    if(n >= nframes)
+        n = nframes - 1;
+    if(n < 0)
+        n = 0;
+    if(header.compression != 1)
+        return lseek(fd, dataoff + n * sizeof(buf), SEEK_SET) < 0 ? -1 : n;
+    if((k = rgb_key(n)) < 0 || lseek(fd, keys[k].off, SEEK_SET) < 0)
+        return -1;
+    return keys[k].frame;
+}
+
+// The sound of an .rgb file is the .wav beside it. It is played from
+// here rather than by playwav so that it can follow a seek, written
+// AUDIO_LEAD ms ahead of the picture like the sound of an MP4.
+static int wfd = -1;
+static struct wavinfo wav;
+static uint64 wavpos;           // sample frames written
+static uchar *wavbuf;
+
+static void
+open_sound(char *name)
+{
+    char wname[MAXPATH];
+    int len = strlen(name);
+
+    if(len >= MAXPATH)
+        return;
+    strcpy(wname, name);
+    strcpy(wname + len - 3, "wav");
+    if((wfd = open(wname, O_RDONLY)) < 0)
+        return;
+    if(wavopen(wfd, &wav) < 0 ||
+       (wavbuf = malloc(AUDIO_SLOT_SIZE / WAV_OUT_FRAME * wav.block_align)) == 0 ||
+       audio_open(wav.sample_rate) < 0){
+        printf("playmp4: cannot play %s\n", wname);
+        close(wfd);
+        wfd = -1;
+    }
+}
+
+static void
+seek_sound(uint ms)
+{
+    if(wfd < 0)
+        return;
+    wavpos = (uint64)ms * wav.sample_rate / 1000;
+    lseek(wfd, wav.data_off + wavpos * wav.block_align, SEEK_SET);
+}
+
+static void
+feed_sound(uint ms)
+{
+    uint64 want = (uint64)(ms + AUDIO_LEAD) * wav.sample_rate / 1000;
+    int n;
+
+    if(wfd < 0)
+        return;
+    if(want > wav.data_len / wav.block_align)
+        want = wav.data_len / wav.block_align;
+    while(wavpos < want){
+        n = want - wavpos;
+        if(n > AUDIO_SLOT_SIZE / WAV_OUT_FRAME)
+            n = AUDIO_SLOT_SIZE / WAV_OUT_FRAME;
+        if((n = read(wfd, wavbuf, n * wav.block_align) / wav.block_align) <= 0)
+            break;
+        audio_write(out, wavconvert(wavbuf, n, &wav, out));
+        wavpos += n;
+    }
+}
+
+static void
+play_rgb(char *name)
+{
+    struct stat st;
+    struct rgbframe f;
+    uchar *rle = 0;
+    uint64 bytes = 0;
+    int n = 0, k, ms, due, t0, decoded = 0, shown = 0, late = 0, skipped = 0, tiles = 0;
+
+    loadVideo(name);
+    if(read(fd, &header, sizeof(header)) != sizeof(header) || header.type != RGB_MAGIC){
+        // a plain stream
+        memset(&header, 0, sizeof(header));
+    } else if(header.width != WINDOW_WIDTH || header.height != WINDOW_HEIGHT ||
+              header.bytesPerPixel != 2){
+        printf("playmp4: %s is not 320x200 RGB565\n", name);
+        exit(1);
+    } else {
+        dataoff = sizeof(header);
+    }
+    frametime = header.frametime ? header.frametime : RGB_FRAMETIME;
+    if(header.compression == 1){
+        t0 = uptime();
+        if(rgb_index() < 0 || (rle = malloc(RGB_MAXFRAME)) == 0){
+            printf("playmp4: cannot index %s\n", name);
+            exit(1);
+        }
+        printf("playmp4: %d frames, %d key frames, indexed in %d ms\n",
+               nframes, nkeys, (uptime() - t0) * 1000 / TICKS_PER_SEC);
+    } else {
+        fstat(fd, &st);
+        nframes = (st.size - dataoff) / sizeof(buf);
+        lseek(fd, dataoff, SEEK_SET);
+    }
+    open_sound(name);
 
-    update = 1;
     reg_keycb(key_handle);
-    int frame = 0;
-    while(1) {
-        if(update) {
-            draw();
-            show_window((char *) fbuf);
-            update = 0;
+    clock_set(0);
+    while(n < nframes){
+        if(seekreq){
+            ms = frame_ms(n) + seek_take();
+            if((k = rgb_seek((uint64)(ms < 0 ? 0 : ms) * 1000 / frametime)) >= 0)
+                n = k;
+            clock_set(frame_ms(n));
+            seek_sound(frame_ms(n));
+        }
+        ms = frame_ms(n);
+        if(speed != clock_speed){
+            clock_set(ms);
+            seek_sound(ms);
+        }
+        if(clock_speed == 1)
+            feed_sound(ms);
+
+        // Behind time whole frames go unread: in a plain stream the
+        // late one, in a compressed one all up to the last key frame
+        // that is already due.
+        due = clock_due(ms);
+        if(uptime() > due + 1){
+            if(header.compression != 1){
+                lseek(fd, sizeof(buf), SEEK_CUR);
+                n++;
+                skipped++;
+                continue;
+            }
+            for(k = rgb_key(n) + 1; k < nkeys && uptime() > clock_due(frame_ms(keys[k].frame)); k++)
+                ;
+            if(k - 1 >= 0 && keys[k - 1].frame > n){
+                lseek(fd, keys[k - 1].off, SEEK_SET);
+                skipped += keys[k - 1].frame - n;
+                n = keys[k - 1].frame;
+                due = clock_due(frame_ms(n));
+            }
+        }
+
+        if(header.compression == 1){
+            if(read(fd, &f, sizeof(f)) != sizeof(f) || f.size > RGB_MAXFRAME ||
+               read(fd, rle, f.size) != (int)f.size ||
+               rgb_tiles(rle, rle + f.size, f.ntiles, (char *) fbuf) < 0){
+                printf("playmp4: bad frame %d\n", n);
+                break;
+            }
+            bytes += sizeof(f) + f.size;
+            tiles += f.ntiles;
+        } else {
+            if(read(fd, buf, sizeof(buf)) != sizeof(buf))
+                break;
+            bytes += sizeof(buf);
+            rgb_convert(buf, (char *) fbuf, WINDOW_WIDTH * WINDOW_HEIGHT);
+            f.ntiles = RGB_NTILES;
+        }
+        n++;
+        decoded++;
+        // A compressed frame only rewrites the tiles it carries, so
+        // one without tiles is not shown, and a late one is still
+        // decoded as the next one builds on it.
+        if(f.ntiles == 0)
+            continue;
+        if(uptime() > due + 1){
+            late++;
+            continue;
         }
-        sleep(1);
-        update = 1;
+        if(uptime() < due)
+            sleep(due - uptime());
+        show_window((char *) fbuf);
+        shown++;
+        seek_done();
     }
     close_window();
+    if(wfd >= 0)
+        audio_close();
+    printf("playmp4: %d frames decoded, %d shown, %d late, %d skipped unread, %d KB read\n",
+           decoded, shown, late, skipped, (int)(bytes / 1024));
+    if(header.compression == 1)
+        printf("playmp4: %d of %d tiles drawn\n", tiles, decoded * RGB_NTILES);
+    seek_report();
+    if(rle)
+        free(rle);
+}
+
+int main(int argc, char *argv[]) {
+    int benchmark = 0;
+
+    if(argc > 1 && strcmp(argv[1], "-b") == 0){
+        benchmark = 1;
+        argv++;
+        argc--;
+    }
+    if(argc < 2){
+        printf("Usage: playmp4 [-b] *.mp4 | *.rgb\n");
+        exit(1);
+    }
+    int len = strlen(argv[1]);
+    if(len > 4 && strcmp(argv[1] + len - 4, ".rgb") == 0)
+        play_rgb(argv[1]);
+    else
+        play_mp4(argv[1], benchmark);
     exit(0);
-}
\ No newline at end of file
+}
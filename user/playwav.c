@@ -3,73 +3,90 @@
 #include "kernel/sound.h"
 #include "kernel/fcntl.h"
 #include "user/user.h"
+#include "user/wav.h"
+#include "user/audio.h"
 
-#define SINGLE_BUF_SIZE 4096
-#define BUF_SIZE  (SINGLE_BUF_SIZE * 8)
+// One batch of at most BUF_FRAMES input frames is converted into one
+// audio slot, which holds exactly that many output frames; the batch
+// is capped in frames, not bytes, since converting mono or 8-bit
+// input makes it grow. Raw input frames are at most 8 bytes (32-bit
+// stereo).
+#define BUF_FRAMES (AUDIO_SLOT_SIZE / WAV_OUT_FRAME)
 
-char buf[BUF_SIZE];
+uint inbuf[BUF_FRAMES * 2];     // uint for word alignment
+
+// Read up to n bytes, fewer only at the end of the file.
+static int
+readmax(int fd, char *p, int n)
+{
+    int tot, m;
+
+    for(tot = 0; tot < n; tot += m)
+        if((m = read(fd, p + tot, n - tot)) <= 0)
+            break;
+    return tot;
+}
 
 int
 main(int argc, char *argv[])
 {
-    int i;
-    int fd;
-    struct wav info;
-    fd = open(argv[1], O_RDWR);
+    int fd, n, len;
+    struct wavinfo info;
+
+    if(argc < 2) {
+        printf("usage: playwav file.wav\n");
+        exit(0);
+    }
+    fd = open(argv[1], O_RDONLY);
     if (fd < 0) {
         printf("open wav file fail\n");
         exit(0);
     }
-
-    read(fd, &info, sizeof(struct wav));
-    if ((info.riff_id != 0x46464952)||(info.wave_id != 0x45564157)) {
-        printf("invalid file format\n");
+    if(wavopen(fd, &info) < 0) {
         close(fd);
         exit(0);
     }
-
-    if ((info.info.id != 0x20746d66)||
-        (info.info.channel != 0x0002)||
-        (info.info.bytes_per_sample != 0x0004)||
-        (info.info.bits_per_sample != 0x0010)) {
-        printf("data encoded in an unaccepted way\n");
-        printf("id=%x\n", info.info.id);
-        printf("channel=%x\n", info.info.channel);
-        printf("bytes_per_sample=%x\n", info.info.bytes_per_sample);
-        printf("bits_per_sample=%x\n", info.info.bits_per_sample);
+    if(info.block_align > sizeof(inbuf) / BUF_FRAMES) {
+        printf("playwav: %d-byte frames are too big\n", info.block_align);
         close(fd);
         exit(0);
     }
+    // 16-bit stereo is what the card plays, pass it straight through.
+    int native = info.format == WAV_FORMAT_PCM && info.channel == 2 &&
+                 info.bits_per_sample == 16;
 
-    if(info.data_id == 0x5453494C) {  // LIST chunk
-        read(fd, buf, info.dlen);
-        read(fd, &info.data_id, 4);
-        read(fd, &info.dlen, 4);
-    }
-    setSampleRate(info.info.sample_rate);
-    uint rd = 0;
-    int mp3pid = fork();
-    if (mp3pid == 0) {
-        exec("decode", argv);
+    if(audio_open(info.sample_rate) < 0) {
+        printf("playwav: sound card busy\n");
+        close(fd);
         exit(0);
     }
-    while (rd < info.dlen) {
-        int len = (info.dlen - rd < BUF_SIZE ? info.dlen - rd : BUF_SIZE);
-        i = 0;
-        read(fd, buf, len);
-        rd += len;
-        while(len > SINGLE_BUF_SIZE) {
-            kwrite(buf+(i++)*SINGLE_BUF_SIZE, SINGLE_BUF_SIZE);
-            len -= SINGLE_BUF_SIZE;
-        }
-        if(len > 0) {
-            kwrite(buf+i*SINGLE_BUF_SIZE, len);
+    uint rd = 0;
+    while (rd < info.data_len) {
+        len = info.data_len - rd;
+        if(native) {
+            // straight from the file into the DMA buffer
+            if(len > AUDIO_SLOT_SIZE)
+                len = AUDIO_SLOT_SIZE;
+            len -= len % info.block_align;
+            if(len == 0 || (n = readmax(fd, (char*)audio_slot(), len)) <= 0)
+                break;
+            n -= n % info.block_align;
+            rd += n;
+            audio_queue(n);
+        } else {
+            if(len > BUF_FRAMES * info.block_align)
+                len = BUF_FRAMES * info.block_align;
+            len -= len % info.block_align;
+            if(len == 0 || (n = readmax(fd, (char*)inbuf, len)) <= 0)
+                break;
+            n -= n % info.block_align;
+            rd += n;
+            n = wavconvert((uchar*)inbuf, n / info.block_align, &info, audio_slot());
+            audio_queue(n);
         }
     }
+    audio_close();
 
     close(fd);
-    kill(mp3pid);
-    wait(0);
     exit(0);
 }
-
@@ -0,0 +1,56 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/rgb.h"
+
+// format rrrr rggg gggb bbbb -> rrgggbbb
+static int
+rgb8(uint v)
+{
+    return (v >> 14) << 6 | ((v >> 8) & 7) << 3 | ((v >> 2) & 7);
+}
+
+void
+rgb_convert(const uint16 *src, char *dst, int n)
+{
+    int i;
+
+    for(i = 0; i < n; i++)
+        dst[i] = rgb8(src[i]);
+}
+
+// Only the tiles the frame carries are written, so fb has to hold
+// the frame before. Returns -1 if the frame is malformed.
+int
+rgb_tiles(const uchar *p, const uchar *end, int ntiles, char *fb)
+{
+    int t, i, n, c, v;
+    char *tile;
+
+    while(ntiles-- > 0){
+        if(end - p < 2)
+            return -1;
+        t = p[0] | p[1] << 8;
+        p += 2;
+        if(t >= RGB_NTILES)
+            return -1;
+        tile = fb + t / RGB_TILES_X * RGB_TILE_H * RGB_WIDTH + t % RGB_TILES_X * RGB_TILE_W;
+        for(i = 0; i < RGB_TILE_PIXELS; ){
+            if(p >= end)
+                return -1;
+            c = *p++;
+            n = c < 128 ? c + 1 : c - 126;
+            if(i + n > RGB_TILE_PIXELS || end - p < (c < 128 ? 2 * n : 2))
+                return -1;
+            if(c < 128){
+                for(; n > 0; n--, i++, p += 2)
+                    tile[i / RGB_TILE_W * RGB_WIDTH + i % RGB_TILE_W] = rgb8(p[0] | p[1] << 8);
+            } else {
+                v = rgb8(p[0] | p[1] << 8);
+                p += 2;
+                for(; n > 0; n--, i++)
+                    tile[i / RGB_TILE_W * RGB_WIDTH + i % RGB_TILE_W] = v;
+            }
+        }
+    }
+    return p == end ? 0 : -1;
+}
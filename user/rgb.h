@@ -0,0 +1,61 @@
+#ifndef _RGB_H_
+#define _RGB_H_
+
+// .rgb video for playmp4. A plain .rgb file is nothing but raw
+// 320x200 RGB565 little-endian frames, as ffmpeg writes them. A file
+// made by mkfs/rgbenc starts with a 512-byte SGI-style header; with
+// compression 1 the frames that follow are tile-RLE coded.
+
+#define RGB_MAGIC       474         // SGI image file magic
+#define RGB_WIDTH       320
+#define RGB_HEIGHT      200
+#define RGB_FRAMETIME   100000      // us, of plain .rgb files
+
+struct RGB_Header {
+    uint16 type;            // RGB_MAGIC
+    uint8 compression;      // 0 = uncompressed, 1 = RLE compressed
+    uint8 bytesPerPixel;    // 1 = 8 bit, 2 = 16 bit
+    uint16 dimension;
+    uint16 width;
+    uint16 height;
+    uint16 channels;
+    uint32 minPixelValue;
+    uint32 maxPixelValue;
+    uint32 frametime;       // us per frame, 0 for RGB_FRAMETIME
+    char name[80];
+    uint32 colorMapID;
+    char dummy[404];
+};
+
+// The picture is cut into RGB_TILE_W x RGB_TILE_H tiles, numbered
+// row by row. An RLE frame is a struct rgbframe, then for each tile
+// it carries the tile number (uint16) and the tile's pixels, row by
+// row, as runs. A run starts with a control byte c: for c < 128, c+1
+// literal pixels follow; otherwise the one pixel that follows
+// repeats c-126 times. A key frame carries every tile, a delta frame
+// only the tiles that differ from the frame before. All numbers are
+// little-endian.
+#define RGB_TILE_W      16
+#define RGB_TILE_H      8
+#define RGB_TILES_X     (RGB_WIDTH / RGB_TILE_W)
+#define RGB_TILES_Y     (RGB_HEIGHT / RGB_TILE_H)
+#define RGB_NTILES      (RGB_TILES_X * RGB_TILES_Y)
+#define RGB_TILE_PIXELS (RGB_TILE_W * RGB_TILE_H)
+
+#define RGB_KEY         1           // rgbframe.flags
+
+struct rgbframe {
+    uint32 size;            // bytes of tiles after this header
+    uint16 ntiles;
+    uint16 flags;
+};
+
+// a frame at its worst: every tile, every pixel a one-pixel literal
+#define RGB_MAXFRAME    (RGB_NTILES * (2 + RGB_TILE_PIXELS * 3))
+
+// Conversion into a RGB_WIDTH x RGB_HEIGHT window buffer of
+// rrgggbbb bytes: n plain pixels, or the tiles of an RLE frame.
+void rgb_convert(const uint16 *src, char *dst, int n);
+int rgb_tiles(const uchar *p, const uchar *end, int ntiles, char *fb);
+
+#endif // _RGB_H_
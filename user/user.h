@@ -23,6 +23,8 @@ int getpid(void);
 char* sbrk(int);
 int sleep(int);
 int uptime(void);
+int lseek(int, int, int);
+int mount(int, const char*);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -60,4 +62,8 @@ int beginDecode();
 int waitForDecode();
 int endDecode();
 int getCoreBuf();
-int kwrite(void*, int);
\ No newline at end of file
+int kwrite(void*, int);
+int audiopin(void*, int);
+int audioqueue(int);
+int audiowait(void);
+int ntas(int);
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
+#include "kernel/sound.h"
 
 //
 // Tests xv6 system calls.  usertests without arguments runs them all
@@ -18,6 +19,7 @@
 //
 
 #define BUFSZ  ((MAXOPBLOCKS+2)*BSIZE)
+#define MAXBIG (0xffffffffU / BSIZE)  // BSIZE blocks in the biggest file
 
 char buf[BUFSZ];
 
@@ -335,6 +337,76 @@ truncate1(char *s)
   close(fd3);
 }
 
+// lseek() moves the offset that read and write use, and refuses
+// negative offsets, unknown whence values and pipes.
+void
+lseektest(char *s)
+{
+  char buf[16];
+  int fd, fds[2], i;
+
+  unlink("lseekfile");
+  fd = open("lseekfile", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf("%s: create failed\n", s);
+    exit(1);
+  }
+  for(i = 0; i < 1000; i++){
+    buf[0] = 'a' + i % 26;
+    if(write(fd, buf, 1) != 1){
+      printf("%s: write failed\n", s);
+      exit(1);
+    }
+  }
+  if(lseek(fd, 0, SEEK_CUR) != 1000 || lseek(fd, 0, SEEK_END) != 1000){
+    printf("%s: wrong offset after write\n", s);
+    exit(1);
+  }
+  if(lseek(fd, 500, SEEK_SET) != 500 || read(fd, buf, 2) != 2 ||
+     buf[0] != 'a' + 500 % 26 || buf[1] != 'a' + 501 % 26){
+    printf("%s: SEEK_SET read wrong data\n", s);
+    exit(1);
+  }
+  if(lseek(fd, -102, SEEK_CUR) != 400 || read(fd, buf, 1) != 1 ||
+     buf[0] != 'a' + 400 % 26){
+    printf("%s: SEEK_CUR read wrong data\n", s);
+    exit(1);
+  }
+  if(lseek(fd, -1, SEEK_END) != 999 || read(fd, buf, 2) != 1 ||
+     buf[0] != 'a' + 999 % 26){
+    printf("%s: SEEK_END read wrong data\n", s);
+    exit(1);
+  }
+  if(lseek(fd, 100, SEEK_END) != 1100 || read(fd, buf, 1) != 0){
+    printf("%s: read past the end\n", s);
+    exit(1);
+  }
+  if(lseek(fd, -1, SEEK_SET) != -1 || lseek(fd, -2000, SEEK_END) != -1 ||
+     lseek(fd, 0, 3) != -1 || lseek(fd, 0, SEEK_CUR) != 1100){
+    printf("%s: bad lseek accepted\n", s);
+    exit(1);
+  }
+  lseek(fd, 0, SEEK_SET);
+  if(write(fd, "XY", 2) != 2 || lseek(fd, 0, SEEK_SET) != 0 ||
+     read(fd, buf, 3) != 3 || buf[0] != 'X' || buf[1] != 'Y' || buf[2] != 'c'){
+    printf("%s: write after lseek\n", s);
+    exit(1);
+  }
+  close(fd);
+  unlink("lseekfile");
+
+  if(pipe(fds) != 0){
+    printf("%s: pipe failed\n", s);
+    exit(1);
+  }
+  if(lseek(fds[0], 0, SEEK_SET) != -1){
+    printf("%s: lseek on a pipe\n", s);
+    exit(1);
+  }
+  close(fds[0]);
+  close(fds[1]);
+}
+
 // write to an open FD whose file has just been truncated.
 // this causes a write at an offset beyond the end of the file.
 // such writes fail on xv6 (unlike POSIX) but at least
@@ -580,7 +652,7 @@ writebig(char *s)
     exit(1);
   }
 
-  for(i = 0; i < MAXFILE; i++){
+  for(i = 0; i < MAXBIG; i++){
     ((int*)buf)[0] = i;
     if(write(fd, buf, BSIZE) != BSIZE){
       printf("%s: error: write big file failed\n", s, i);
@@ -600,7 +672,7 @@ writebig(char *s)
   for(;;){
     i = read(fd, buf, BSIZE);
     if(i == 0){
-      if(n == MAXFILE - 1){
+      if(n == MAXBIG - 1){
         printf("%s: read only %d blocks from big", s, n);
         exit(1);
       }
@@ -2669,6 +2741,47 @@ badarg(char *s)
   exit(0);
 }
 
+// audiopin() must refuse buffers the DMA engine cannot use, and
+// must forget pinned pages once sbrk() gives them back.
+void
+audiopintest(char *s)
+{
+  char *a = sbrk(0);
+  char *buf;
+
+  sbrk(PGROUNDUP((uint64)a) - (uint64)a);
+  buf = sbrk(AUDIO_SLOTS * AUDIO_SLOT_SIZE);
+  if(buf == (char*)-1){
+    printf("%s: sbrk failed\n", s);
+    exit(1);
+  }
+  if(audiopin(buf + 1, AUDIO_SLOT_SIZE) != -1 ||
+     audiopin(buf, AUDIO_SLOT_SIZE + 1) != -1 ||
+     audiopin(buf, (AUDIO_SLOTS + 1) * AUDIO_SLOT_SIZE) != -1 ||
+     audiopin(buf + PGSIZE, AUDIO_SLOTS * AUDIO_SLOT_SIZE) != -1 ||
+     audiopin((char*)0xffffffffff00L, AUDIO_SLOT_SIZE) != -1){
+    printf("%s: audiopin accepted a bad buffer\n", s);
+    exit(1);
+  }
+  if(audiopin(buf, AUDIO_SLOTS * AUDIO_SLOT_SIZE) != AUDIO_SLOTS){
+    printf("%s: audiopin failed\n", s);
+    exit(1);
+  }
+  if(audiowait() != -1 || audioqueue(AUDIO_SLOTS) != -1){
+    printf("%s: audiowait/audioqueue on idle slots\n", s);
+    exit(1);
+  }
+  sbrk(-AUDIO_SLOTS * AUDIO_SLOT_SIZE);
+  if(audioqueue(0) != -1){
+    printf("%s: slot still pinned after sbrk\n", s);
+    exit(1);
+  }
+  if(audiopin(0, 0) != 0){
+    printf("%s: unpin failed\n", s);
+    exit(1);
+  }
+}
+
 // test the exec() code that cleans up if it runs out
 // of memory. it's really a test that such a condition
 // doesn't cause a panic.
@@ -2830,11 +2943,13 @@ main(int argc, char *argv[])
     {truncate1, "truncate1"},
     {truncate2, "truncate2"},
     {truncate3, "truncate3"},
+    {lseektest, "lseek"},
     {reparent2, "reparent2"},
     {pgbug, "pgbug" },
     {sbrkbugs, "sbrkbugs" },
     // {badwrite, "badwrite" },
     {badarg, "badarg" },
+    {audiopintest, "audiopin" },
     {reparent, "reparent" },
     {twochildren, "twochildren"},
     {forkfork, "forkfork"},
@@ -36,6 +36,8 @@ entry("getpid");
 entry("sbrk");
 entry("sleep");
 entry("uptime");
+entry("lseek");
+entry("mount");
 
 entry("create_sem");
 entry("free_sem");
@@ -51,4 +53,8 @@ entry("memory");
 entry("setSampleRate");
 entry("pause");
 entry("wavdecode");
-entry("kwrite");
\ No newline at end of file
+entry("kwrite");
+entry("audiopin");
+entry("audioqueue");
+entry("audiowait");
+entry("ntas");
\ No newline at end of file
@@ -0,0 +1,341 @@
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/wav.h"
+
+// RIFF/WAVE chunk walker.
+//
+// A WAVE file is a RIFF header followed by a list of chunks in no
+// particular order: "fmt ", "data", and any number of LIST, fact,
+// cue, id3 ... chunks that we do not care about. Each chunk is an
+// 8-byte {id, len} header plus len bytes padded to an even size.
+
+static uchar skipbuf[512];
+
+static int
+readfull(int fd, void *dst, int n)
+{
+    int tot, m;
+
+    for(tot = 0; tot < n; tot += m){
+        if((m = read(fd, (char*)dst + tot, n - tot)) <= 0)
+            return -1;
+    }
+    return 0;
+}
+
+// Skip n bytes of the stream by reading them away; chunks between
+// fmt and data are small, and this works on pipes too.
+static int
+skip(int fd, uint n)
+{
+    uint m;
+
+    while(n > 0){
+        m = n < sizeof(skipbuf) ? n : sizeof(skipbuf);
+        if(readfull(fd, skipbuf, m) < 0)
+            return -1;
+        n -= m;
+    }
+    return 0;
+}
+
+static ushort
+le16(const uchar *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static uint
+le32(const uchar *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint)p[3] << 24;
+}
+
+// Walk the chunks of the WAVE file open on fd and fill in info.
+// On success the file is positioned at the first sample.
+int
+wavopen(int fd, struct wavinfo *info)
+{
+    uint riff[3];
+    struct chunk ck;
+    uchar fmt[40];
+    uint off, n;
+    int havefmt = 0;
+
+    memset(info, 0, sizeof(*info));
+    if(readfull(fd, riff, sizeof(riff)) < 0 ||
+       riff[0] != WAV_RIFF_ID || riff[2] != WAV_WAVE_ID){
+        fprintf(2, "wav: not a RIFF/WAVE file\n");
+        return -1;
+    }
+    off = sizeof(riff);
+
+    for(;;){
+        if(readfull(fd, &ck, sizeof(ck)) < 0){
+            fprintf(2, "wav: no data chunk\n");
+            return -1;
+        }
+        off += sizeof(ck);
+
+        if(ck.id == WAV_DATA_ID){
+            if(!havefmt){
+                fprintf(2, "wav: data chunk before fmt chunk\n");
+                return -1;
+            }
+            info->data_off = off;
+            info->data_len = ck.len;
+            break;
+        }
+
+        n = ck.len + (ck.len & 1);
+        if(ck.id == WAV_FMT_ID){
+            if(ck.len < 16){
+                fprintf(2, "wav: short fmt chunk\n");
+                return -1;
+            }
+            uint m = ck.len < sizeof(fmt) ? ck.len : sizeof(fmt);
+            if(readfull(fd, fmt, m) < 0 || skip(fd, n - m) < 0)
+                return -1;
+            info->format = le16(fmt);
+            info->channel = le16(fmt + 2);
+            info->sample_rate = le32(fmt + 4);
+            info->block_align = le16(fmt + 12);
+            info->bits_per_sample = le16(fmt + 14);
+            // WAVE_FORMAT_EXTENSIBLE keeps the real format code
+            // in the first two bytes of the sub-format GUID.
+            if(info->format == WAV_FORMAT_EXTENSIBLE && m >= 26)
+                info->format = le16(fmt + 24);
+            havefmt = 1;
+        } else if(skip(fd, n) < 0){
+            return -1;
+        }
+        off += n;
+    }
+
+    if((info->format != WAV_FORMAT_PCM && info->format != WAV_FORMAT_FLOAT) ||
+       (info->channel != 1 && info->channel != 2) ||
+       (info->format == WAV_FORMAT_PCM && info->bits_per_sample != 8 &&
+        info->bits_per_sample != 16 && info->bits_per_sample != 24 &&
+        info->bits_per_sample != 32) ||
+       (info->format == WAV_FORMAT_FLOAT && info->bits_per_sample != 32) ||
+       info->block_align != info->channel * (info->bits_per_sample / 8)){
+        fprintf(2, "wav: unsupported encoding: format %d, %d channels, %d bits\n",
+                info->format, info->channel, info->bits_per_sample);
+        return -1;
+    }
+    return 0;
+}
+
+// Converters. Each handles four samples per iteration using word
+// loads where the source is aligned, then finishes the tail one
+// sample at a time.
+
+// Duplicate every mono sample into both channels. Works from the
+// end backwards so that src may equal dst (in-place expansion).
+void
+pcm_mono_to_stereo(const short *src, short *dst, int nframes)
+{
+    int i = nframes;
+
+    while(i >= 4){
+        i -= 4;
+        short s0 = src[i], s1 = src[i+1], s2 = src[i+2], s3 = src[i+3];
+        dst[2*i+7] = dst[2*i+6] = s3;
+        dst[2*i+5] = dst[2*i+4] = s2;
+        dst[2*i+3] = dst[2*i+2] = s1;
+        dst[2*i+1] = dst[2*i] = s0;
+    }
+    while(i > 0){
+        i--;
+        short s = src[i];
+        dst[2*i+1] = dst[2*i] = s;
+    }
+}
+
+// Unsigned 8-bit: flipping the top bit turns offset-binary into
+// two's complement, then scale to 16 bits.
+void
+pcm_u8_to_s16(const uchar *src, short *dst, int nsamples)
+{
+    int i = 0;
+
+    if(((uint64)src & 3) == 0){
+        for(; i + 4 <= nsamples; i += 4){
+            uint w = *(uint*)(src + i) ^ 0x80808080;
+            dst[i] = (short)((w & 0xff) << 8);
+            dst[i+1] = (short)(w & 0xff00);
+            dst[i+2] = (short)((w >> 8) & 0xff00);
+            dst[i+3] = (short)((w >> 16) & 0xff00);
+        }
+    }
+    for(; i < nsamples; i++)
+        dst[i] = (short)((src[i] ^ 0x80) << 8);
+}
+
+// Signed 24-bit little-endian: keep the two high bytes.
+// Four samples are exactly three words.
+void
+pcm_s24_to_s16(const uchar *src, short *dst, int nsamples)
+{
+    int i = 0;
+
+    if(((uint64)src & 3) == 0){
+        const uint *w = (const uint*)src;
+        for(; i + 4 <= nsamples; i += 4, w += 3){
+            uint w0 = w[0], w1 = w[1], w2 = w[2];
+            dst[i] = (short)(w0 >> 8);
+            dst[i+1] = (short)w1;
+            dst[i+2] = (short)((w1 >> 24) | (w2 << 8));
+            dst[i+3] = (short)(w2 >> 16);
+        }
+    }
+    for(; i < nsamples; i++)
+        dst[i] = (short)(src[3*i+1] | src[3*i+2] << 8);
+}
+
+// Signed 32-bit little-endian: keep the high half.
+void
+pcm_s32_to_s16(const uchar *src, short *dst, int nsamples)
+{
+    int i = 0;
+
+    if(((uint64)src & 3) == 0){
+        const uint *w = (const uint*)src;
+        for(; i + 4 <= nsamples; i += 4){
+            dst[i] = (short)(w[i] >> 16);
+            dst[i+1] = (short)(w[i+1] >> 16);
+            dst[i+2] = (short)(w[i+2] >> 16);
+            dst[i+3] = (short)(w[i+3] >> 16);
+        }
+    }
+    for(; i < nsamples; i++)
+        dst[i] = (short)(src[4*i+2] | src[4*i+3] << 8);
+}
+
+// The IEEE float with bits w, times 32767 and truncated like a C
+// cast, clipped to [-1, 1]. Done on the bits so that playwav needs
+// no floating point.
+static short
+f2s16(uint w)
+{
+    int e = (w >> 23) & 0xff, shift = 150 - e, v;
+
+    if(e >= 127)
+        return w >> 31 ? -32768 : 32767;
+    if(shift >= 40)     // the 24-bit mantissa times 32767 is below 2^39
+        return 0;
+    v = ((uint64)((w & 0x7fffff) | 0x800000) * 32767) >> shift;
+    return w >> 31 ? -v : v;
+}
+
+// 32-bit IEEE float in [-1, 1], clipped.
+void
+pcm_f32_to_s16(const uchar *src, short *dst, int nsamples)
+{
+    int i = 0;
+
+    if(((uint64)src & 3) == 0){
+        const uint *w = (const uint*)src;
+        for(; i + 4 <= nsamples; i += 4){
+            dst[i] = f2s16(w[i]);
+            dst[i+1] = f2s16(w[i+1]);
+            dst[i+2] = f2s16(w[i+2]);
+            dst[i+3] = f2s16(w[i+3]);
+        }
+    }
+    for(; i < nsamples; i++){
+        uint w;
+        memmove(&w, src + 4*i, sizeof(w));
+        dst[i] = f2s16(w);
+    }
+}
+
+// Convert nframes frames of src, laid out as described by info, into
+// 16-bit stereo at dst. dst must have room for nframes*WAV_OUT_FRAME
+// bytes and must not overlap src. Returns the number of bytes written.
+int
+wavconvert(const uchar *src, int nframes, const struct wavinfo *info, short *dst)
+{
+    int nsamples = nframes * info->channel;
+    short *out = dst;
+
+    if(info->format == WAV_FORMAT_FLOAT){
+        pcm_f32_to_s16(src, out, nsamples);
+    } else {
+        switch(info->bits_per_sample){
+        case 8:
+            pcm_u8_to_s16(src, out, nsamples);
+            break;
+        case 16:
+            memmove(out, src, nsamples * 2);
+            break;
+        case 24:
+            pcm_s24_to_s16(src, out, nsamples);
+            break;
+        case 32:
+            pcm_s32_to_s16(src, out, nsamples);
+            break;
+        default:
+            return -1;
+        }
+    }
+    // mono samples land in the first half of dst; spread them out.
+    if(info->channel == 1)
+        pcm_mono_to_stereo(dst, dst, nframes);
+    return nframes * WAV_OUT_FRAME;
+}
+
+static const short ima_step[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31,
+    34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
+    157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+    724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
+    3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const signed char ima_index[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+// Decode one packet per channel at src into IMA4_FRAMES frames of
+// 16-bit stereo at dst. Returns the number of bytes written.
+int
+ima4_decode(const uchar *src, int channels, short *dst)
+{
+    int ch, i, n, step, diff, pred, index;
+
+    for(ch = 0; ch < channels; ch++, src += IMA4_PACKET){
+        // 9 bits of predictor, 7 of step index
+        pred = (short)((src[0] << 8 | src[1]) & 0xff80);
+        index = src[1] & 0x7f;
+        if(index > 88)
+            index = 88;
+        for(i = 0; i < IMA4_FRAMES; i++){
+            n = src[2 + i / 2] >> (4 * (i & 1)) & 0xf;
+            step = ima_step[index];
+            diff = step >> 3;
+            if(n & 1)
+                diff += step >> 2;
+            if(n & 2)
+                diff += step >> 1;
+            if(n & 4)
+                diff += step;
+            pred += n & 8 ? -diff : diff;
+            if(pred > 32767)
+                pred = 32767;
+            if(pred < -32768)
+                pred = -32768;
+            index += ima_index[n];
+            if(index < 0)
+                index = 0;
+            if(index > 88)
+                index = 88;
+            dst[2 * i + ch] = pred;
+        }
+    }
+    if(channels == 1)
+        for(i = 0; i < IMA4_FRAMES; i++)
+            dst[2 * i + 1] = dst[2 * i];
+    return IMA4_FRAMES * WAV_OUT_FRAME;
+}
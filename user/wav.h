@@ -0,0 +1,51 @@
+#ifndef _WAV_H_
+#define _WAV_H_
+
+// RIFF/WAVE parsing and PCM conversion for the audio players.
+// The AC97 driver only plays 16-bit little-endian stereo, so
+// every other layout is converted in user space before playback.
+
+#define WAV_RIFF_ID  0x46464952  // "RIFF"
+#define WAV_WAVE_ID  0x45564157  // "WAVE"
+#define WAV_FMT_ID   0x20746d66  // "fmt "
+#define WAV_DATA_ID  0x61746164  // "data"
+
+#define WAV_FORMAT_PCM        0x0001
+#define WAV_FORMAT_FLOAT      0x0003
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+
+// bytes per frame once converted: s16 stereo
+#define WAV_OUT_FRAME 4
+
+struct chunk {
+    uint id;
+    uint len;
+};
+
+struct wavinfo {
+    ushort format;          // WAV_FORMAT_PCM or WAV_FORMAT_FLOAT
+    ushort channel;         // 1 or 2
+    uint sample_rate;
+    ushort bits_per_sample; // 8, 16, 24 or 32
+    ushort block_align;     // bytes per input frame
+    uint data_off;          // file offset of the first sample
+    uint data_len;          // bytes of sample data
+};
+
+int  wavopen(int fd, struct wavinfo *info);
+int  wavconvert(const uchar *src, int nframes, const struct wavinfo *info, short *dst);
+void pcm_mono_to_stereo(const short *src, short *dst, int nframes);
+void pcm_u8_to_s16(const uchar *src, short *dst, int nsamples);
+void pcm_s24_to_s16(const uchar *src, short *dst, int nsamples);
+void pcm_s32_to_s16(const uchar *src, short *dst, int nsamples);
+void pcm_f32_to_s16(const uchar *src, short *dst, int nsamples);
+
+// QuickTime IMA ADPCM ('ima4'): each channel is coded in packets of
+// IMA4_PACKET bytes holding IMA4_FRAMES samples, and the channels'
+// packets alternate.
+#define IMA4_PACKET 34
+#define IMA4_FRAMES 64
+
+int  ima4_decode(const uchar *src, int channels, short *dst);
+
+#endif // _WAV_H_